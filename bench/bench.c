@@ -0,0 +1,597 @@
+/*
+ * A multi-threaded benchmark for the SDK's transaction hot path.
+ *
+ * Each worker thread runs transactions of a configurable shape back to back
+ * for the duration of the benchmark, timing each call to
+ * newrelic_end_transaction(). By default transaction data is handed to the
+ * in-process loopback daemon, which discards it; with --daemon it is written
+ * to a socket owned by the benchmark and relayed to a running daemon. Either
+ * way the bytes sent are counted, so the size of each transaction can be
+ * reported alongside the throughput and latency.
+ *
+ * See README.md for usage.
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libnewrelic.h"
+#include "global.h"
+
+#include "nr_agent.h"
+#include "nr_axiom.h"
+#include "nr_loopback.h"
+
+/*
+ * Latencies are recorded in a log-linear histogram of nanoseconds: each
+ * power of two is split into HIST_SUB_COUNT equal buckets, which bounds the
+ * error of any reported percentile to about 3%.
+ */
+#define HIST_SUB_BITS 5
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (64 * HIST_SUB_COUNT)
+
+typedef struct _bench_hist_t {
+  uint64_t counts[HIST_BUCKETS];
+  uint64_t total;
+} bench_hist_t;
+
+typedef struct _bench_options_t {
+  int threads;
+  int duration_s;
+  int segments;
+  int datastore;
+  int external;
+  int attributes;
+  int custom_events;
+  int validate;
+  int aggregate_metrics;
+  int shared_memory;
+  const char* daemon;
+  const char* app_name;
+  const char* license;
+} bench_options_t;
+
+typedef struct _bench_worker_t {
+  pthread_t thread;
+  newrelic_app_t* app;
+  const bench_options_t* options;
+  uint64_t failures;
+  bench_hist_t hist;
+} bench_worker_t;
+
+/*
+ * The socket the SDK sends its data to when --daemon is given. The data is
+ * relayed to the daemon at upstream_path, and replies are relayed back.
+ */
+typedef struct _bench_sink_t {
+  pthread_t thread;
+  int listen_fd;
+  char path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+  const char* upstream_path;
+  uint64_t bytes; /* Bytes written by the SDK */
+} bench_sink_t;
+
+static volatile sig_atomic_t bench_stop = 0;
+
+static uint64_t bench_now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static int bench_hist_index(uint64_t v) {
+  int msb;
+
+  if (v < HIST_SUB_COUNT) {
+    return (int)v;
+  }
+
+  msb = 63 - __builtin_clzll(v);
+  return (msb - HIST_SUB_BITS + 1) * HIST_SUB_COUNT
+         + (int)((v >> (msb - HIST_SUB_BITS)) & (HIST_SUB_COUNT - 1));
+}
+
+static uint64_t bench_hist_value(int index) {
+  int exponent = index / HIST_SUB_COUNT;
+  uint64_t sub = (uint64_t)(index % HIST_SUB_COUNT);
+
+  if (0 == exponent) {
+    return sub;
+  }
+  return (HIST_SUB_COUNT + sub) << (exponent - 1);
+}
+
+static void bench_hist_add(bench_hist_t* hist, uint64_t v) {
+  hist->counts[bench_hist_index(v)]++;
+  hist->total++;
+}
+
+static void bench_hist_merge(bench_hist_t* dest, const bench_hist_t* src) {
+  int i;
+
+  for (i = 0; i < HIST_BUCKETS; i++) {
+    dest->counts[i] += src->counts[i];
+  }
+  dest->total += src->total;
+}
+
+static uint64_t bench_hist_percentile(const bench_hist_t* hist, double p) {
+  uint64_t rank = (uint64_t)(p * (double)hist->total);
+  uint64_t seen = 0;
+  int i;
+
+  for (i = 0; i < HIST_BUCKETS; i++) {
+    seen += hist->counts[i];
+    if (seen > rank) {
+      return bench_hist_value(i);
+    }
+  }
+  return 0;
+}
+
+static int bench_connect_unix(const char* path) {
+  struct sockaddr_un addr;
+  int fd;
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+  if (0 != connect(fd, (struct sockaddr*)&addr, sizeof(addr))) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+static bool bench_write_all(int fd, const char* buf, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, buf, len);
+
+    if (n < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      return false;
+    }
+    buf += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+static void* bench_sink_main(void* arg) {
+  bench_sink_t* sink = (bench_sink_t*)arg;
+  struct pollfd fds[2];
+  char buf[64 * 1024];
+  int client;
+  int upstream;
+
+  client = accept(sink->listen_fd, NULL, NULL);
+  if (client < 0) {
+    return NULL;
+  }
+
+  upstream = bench_connect_unix(sink->upstream_path);
+  if (upstream < 0) {
+    fprintf(stderr, "bench: unable to connect to the daemon at %s: %s\n",
+            sink->upstream_path, strerror(errno));
+    close(client);
+    return NULL;
+  }
+
+  fds[0].fd = client;
+  fds[0].events = POLLIN;
+  fds[1].fd = upstream;
+  fds[1].events = POLLIN;
+
+  for (;;) {
+    ssize_t n;
+
+    if (poll(fds, 2, -1) < 0) {
+      if (EINTR == errno) {
+        continue;
+      }
+      break;
+    }
+
+    if (fds[0].revents) {
+      n = read(client, buf, sizeof(buf));
+      if (n <= 0) {
+        break;
+      }
+      sink->bytes += (uint64_t)n;
+      if (!bench_write_all(upstream, buf, (size_t)n)) {
+        break;
+      }
+    }
+
+    if (fds[1].revents) {
+      n = read(upstream, buf, sizeof(buf));
+      if (n <= 0 || !bench_write_all(client, buf, (size_t)n)) {
+        break;
+      }
+    }
+  }
+
+  close(upstream);
+  close(client);
+  return NULL;
+}
+
+static bool bench_sink_start(bench_sink_t* sink, const char* upstream_path) {
+  struct sockaddr_un addr;
+
+  memset(sink, 0, sizeof(*sink));
+  sink->upstream_path = upstream_path;
+  snprintf(sink->path, sizeof(sink->path), "/tmp/.newrelic-bench-%d.sock",
+           (int)getpid());
+
+  sink->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sink->listen_fd < 0) {
+    return false;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", sink->path);
+  unlink(sink->path);
+
+  if ((0 != bind(sink->listen_fd, (struct sockaddr*)&addr, sizeof(addr)))
+      || (0 != listen(sink->listen_fd, 1))) {
+    close(sink->listen_fd);
+    return false;
+  }
+
+  return 0 == pthread_create(&sink->thread, NULL, bench_sink_main, sink);
+}
+
+static void bench_sink_stop(bench_sink_t* sink) {
+  /* Closing the SDK's end of the connection lets the sink drain everything
+   * that was written before it exits. */
+  nr_agent_close_daemon_connection();
+  pthread_join(sink->thread, NULL);
+  close(sink->listen_fd);
+  unlink(sink->path);
+}
+
+static void bench_transaction(bench_worker_t* w) {
+  static const char* attribute_names[] = {"a0", "a1", "a2", "a3",
+                                          "a4", "a5", "a6", "a7"};
+  const bench_options_t* options = w->options;
+  newrelic_datastore_segment_params_t datastore = {
+      .product = NEWRELIC_DATASTORE_MYSQL,
+      .collection = "users",
+      .operation = "select",
+      .host = "db.example.com",
+      .port_path_or_id = "3306",
+      .database_name = "bench",
+      .query = "SELECT * FROM users WHERE id = ?",
+  };
+  newrelic_external_segment_params_t external = {
+      .uri = "https://api.example.com/v1/items",
+      .procedure = "GET",
+      .library = "curl",
+  };
+  newrelic_txn_t* txn;
+  newrelic_segment_t* segment;
+  uint64_t start;
+  int i;
+
+  txn = newrelic_start_web_transaction(w->app, "bench");
+  if (NULL == txn) {
+    w->failures++;
+    return;
+  }
+
+  for (i = 0; i < options->attributes; i++) {
+    newrelic_add_attribute_int(txn, attribute_names[i % 8], i);
+  }
+
+  for (i = 0; i < options->segments; i++) {
+    segment = newrelic_start_segment(txn, "work", "Custom");
+    newrelic_end_segment(txn, &segment);
+  }
+
+  for (i = 0; i < options->datastore; i++) {
+    segment = newrelic_start_datastore_segment(txn, &datastore);
+    newrelic_end_segment(txn, &segment);
+  }
+
+  for (i = 0; i < options->external; i++) {
+    segment = newrelic_start_external_segment(txn, &external);
+    newrelic_end_segment(txn, &segment);
+  }
+
+  for (i = 0; i < options->custom_events; i++) {
+    newrelic_custom_event_t* event = newrelic_create_custom_event("Bench");
+
+    newrelic_custom_event_add_attribute_int(event, "index", i);
+    newrelic_custom_event_add_attribute_string(event, "shape", "default");
+    newrelic_record_custom_event(txn, &event);
+  }
+
+  start = bench_now_ns();
+  if (!newrelic_end_transaction(&txn)) {
+    w->failures++;
+  }
+  bench_hist_add(&w->hist, bench_now_ns() - start);
+}
+
+static void* bench_worker_main(void* arg) {
+  bench_worker_t* w = (bench_worker_t*)arg;
+
+  while (!bench_stop) {
+    bench_transaction(w);
+  }
+
+  return NULL;
+}
+
+static void bench_usage(FILE* out) {
+  fprintf(out,
+          "Usage: bench [options]\n"
+          "\n"
+          "  -t, --threads N        worker threads (default 4)\n"
+          "  -d, --duration SECS    how long to run (default 10)\n"
+          "  -s, --segments N       custom segments per transaction "
+          "(default 10)\n"
+          "      --datastore N      datastore segments per transaction "
+          "(default 2)\n"
+          "      --external N       external segments per transaction "
+          "(default 2)\n"
+          "  -a, --attributes N     attributes per transaction (default 5)\n"
+          "  -e, --custom-events N  custom events per transaction "
+          "(default 1)\n"
+          "      --validate         check each transaction message before\n"
+          "                         discarding it (loopback only)\n"
+          "      --aggregate-metrics\n"
+          "                         aggregate metrics in the SDK rather than\n"
+          "                         sending them with each transaction\n"
+          "      --daemon PATH      relay to the daemon listening at PATH;\n"
+          "                         NEW_RELIC_LICENSE_KEY must be set\n"
+          "      --shared-memory    send transaction data to the daemon\n"
+          "                         through shared memory (--daemon only)\n"
+          "  -h, --help             show this message\n"
+          "\n"
+          "Without --daemon, transaction data is discarded by the in-process\n"
+          "loopback daemon, which measures the cost of the SDK alone.\n");
+}
+
+static bool bench_parse_options(int argc, char** argv, bench_options_t* o) {
+  static const struct option long_options[] = {
+      {"threads", required_argument, NULL, 't'},
+      {"duration", required_argument, NULL, 'd'},
+      {"segments", required_argument, NULL, 's'},
+      {"datastore", required_argument, NULL, 'D'},
+      {"external", required_argument, NULL, 'E'},
+      {"attributes", required_argument, NULL, 'a'},
+      {"custom-events", required_argument, NULL, 'e'},
+      {"validate", no_argument, NULL, 'V'},
+      {"aggregate-metrics", no_argument, NULL, 'M'},
+      {"daemon", required_argument, NULL, 'S'},
+      {"shared-memory", no_argument, NULL, 'R'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0},
+  };
+  int c;
+
+  o->threads = 4;
+  o->duration_s = 10;
+  o->segments = 10;
+  o->datastore = 2;
+  o->external = 2;
+  o->attributes = 5;
+  o->custom_events = 1;
+  o->validate = 0;
+  o->aggregate_metrics = 0;
+  o->shared_memory = 0;
+  o->daemon = NULL;
+  o->app_name = getenv("NEW_RELIC_APP_NAME");
+  o->license = getenv("NEW_RELIC_LICENSE_KEY");
+
+  while (-1
+         != (c = getopt_long(argc, argv, "t:d:s:a:e:h", long_options, NULL))) {
+    switch (c) {
+      case 't':
+        o->threads = atoi(optarg);
+        break;
+      case 'd':
+        o->duration_s = atoi(optarg);
+        break;
+      case 's':
+        o->segments = atoi(optarg);
+        break;
+      case 'D':
+        o->datastore = atoi(optarg);
+        break;
+      case 'E':
+        o->external = atoi(optarg);
+        break;
+      case 'a':
+        o->attributes = atoi(optarg);
+        break;
+      case 'e':
+        o->custom_events = atoi(optarg);
+        break;
+      case 'V':
+        o->validate = 1;
+        break;
+      case 'M':
+        o->aggregate_metrics = 1;
+        break;
+      case 'S':
+        o->daemon = optarg;
+        break;
+      case 'R':
+        o->shared_memory = 1;
+        break;
+      case 'h':
+        bench_usage(stdout);
+        exit(0);
+      default:
+        bench_usage(stderr);
+        return false;
+    }
+  }
+
+  if (o->threads <= 0 || o->duration_s <= 0) {
+    fprintf(stderr, "bench: threads and duration must be positive\n");
+    return false;
+  }
+
+  if (o->shared_memory && NULL == o->daemon) {
+    fprintf(stderr, "bench: --shared-memory requires --daemon\n");
+    return false;
+  }
+
+  if (NULL == o->app_name) {
+    o->app_name = "C SDK Benchmark";
+  }
+
+  if (NULL == o->license) {
+    if (o->daemon) {
+      fprintf(stderr, "bench: NEW_RELIC_LICENSE_KEY must be set\n");
+      return false;
+    }
+    o->license = "0123456789012345678901234567890123456789";
+  }
+
+  return true;
+}
+
+int main(int argc, char** argv) {
+  bench_options_t options;
+  bench_sink_t sink;
+  nr_loopback_stats_t loopback;
+  bool initialized;
+  uint64_t bytes;
+  bench_worker_t* workers;
+  bench_hist_t* total;
+  newrelic_app_config_t* config;
+  newrelic_app_t* app;
+  uint64_t start;
+  uint64_t elapsed;
+  uint64_t failures = 0;
+  double seconds;
+  int i;
+
+  if (!bench_parse_options(argc, argv, &options)) {
+    return 2;
+  }
+
+  newrelic_configure_log("./c_sdk_bench.log", NEWRELIC_LOG_WARNING);
+
+  if (options.daemon) {
+    if (!bench_sink_start(&sink, options.daemon)) {
+      fprintf(stderr, "bench: unable to create socket: %s\n",
+              strerror(errno));
+      return 1;
+    }
+    if (options.shared_memory && !newrelic_enable_shared_memory(0)) {
+      fprintf(stderr, "bench: unable to enable shared memory\n");
+      return 1;
+    }
+    initialized = newrelic_init(sink.path, 1000);
+  } else {
+    initialized = newrelic_init_loopback(
+        options.validate ? NR_LOOPBACK_VALIDATE : NR_LOOPBACK_DISCARD);
+  }
+
+  if (!initialized) {
+    fprintf(stderr, "bench: unable to initialise the SDK\n");
+    return 1;
+  }
+
+  config = newrelic_create_app_config(options.app_name, options.license);
+  config->aggregate_metrics = options.aggregate_metrics;
+  app = newrelic_create_app(config, 10000);
+  newrelic_destroy_app_config(&config);
+  if (NULL == app) {
+    fprintf(stderr, "bench: unable to connect the application\n");
+    return 1;
+  }
+
+  workers = (bench_worker_t*)calloc((size_t)options.threads, sizeof(*workers));
+  total = (bench_hist_t*)calloc(1, sizeof(*total));
+
+  start = bench_now_ns();
+  for (i = 0; i < options.threads; i++) {
+    workers[i].app = app;
+    workers[i].options = &options;
+    pthread_create(&workers[i].thread, NULL, bench_worker_main, &workers[i]);
+  }
+
+  sleep((unsigned int)options.duration_s);
+  bench_stop = 1;
+
+  for (i = 0; i < options.threads; i++) {
+    pthread_join(workers[i].thread, NULL);
+    bench_hist_merge(total, &workers[i].hist);
+    failures += workers[i].failures;
+  }
+  elapsed = bench_now_ns() - start;
+
+  newrelic_destroy_app(&app);
+  if (options.daemon) {
+    bench_sink_stop(&sink);
+    bytes = sink.bytes;
+  } else {
+    nr_loopback_stop();
+    nr_loopback_get_stats(&loopback);
+    bytes = loopback.bytes;
+    if (loopback.invalid) {
+      fprintf(stderr, "bench: %llu invalid transaction messages\n",
+              (unsigned long long)loopback.invalid);
+      failures += loopback.invalid;
+    }
+  }
+
+  seconds = (double)elapsed / 1e9;
+  printf("mode:         %s\n", options.daemon ? options.daemon : "loopback");
+  printf("shape:        %d segments, %d datastore, %d external, "
+         "%d attributes, %d custom events\n",
+         options.segments, options.datastore, options.external,
+         options.attributes, options.custom_events);
+  printf("threads:      %d\n", options.threads);
+  printf("metrics:      %s\n",
+         options.aggregate_metrics ? "aggregated" : "per transaction");
+  if (options.daemon) {
+    printf("transport:    %s\n",
+           options.shared_memory ? "shared memory" : "socket");
+  }
+  printf("transactions: %llu (%llu failed)\n", (unsigned long long)total->total,
+         (unsigned long long)failures);
+  printf("txn/s:        %.0f\n", (double)total->total / seconds);
+  printf("end p50:      %.1f us\n",
+         (double)bench_hist_percentile(total, 0.50) / 1e3);
+  printf("end p99:      %.1f us\n",
+         (double)bench_hist_percentile(total, 0.99) / 1e3);
+  if (total->total > 0) {
+    printf("bytes/txn:    %.0f\n", (double)bytes / (double)total->total);
+  }
+
+  free(total);
+  free(workers);
+
+  return failures ? 1 : 0;
+}
@@ -23,6 +23,16 @@ typedef struct _nr_app_and_info_t {
 
   /*! The application lock. */
   nrthread_mutex_t lock;
+
+  /*! Custom events recorded outside of transactions; NULL until the first
+   * is recorded. Use newrelic_app_events_get() to read it. */
+  struct _newrelic_app_events_t* events;
+
+  /*! Guards the creation of events. */
+  nrthread_mutex_t events_lock;
+
+  /*! Aggregated transaction metrics; NULL unless aggregate_metrics is set. */
+  struct _newrelic_app_metrics_t* metrics;
 } nr_app_and_info_t;
 
 /*!
@@ -0,0 +1,123 @@
+/*!
+ * @file app_events.h
+ *
+ * @brief Type definitions, constants, and function declarations necessary to
+ * support recording custom events outside of transactions in the C SDK.
+ */
+#ifndef LIBNEWRELIC_APP_EVENTS_H
+#define LIBNEWRELIC_APP_EVENTS_H
+
+#include "libnewrelic.h"
+#include "app_flusher.h"
+#include "nr_analytics_events.h"
+#include "nr_custom_events.h"
+#include "util_random.h"
+#include "util_threads.h"
+
+/*!
+ * @brief The number of reservoirs app-level custom events are spread across.
+ *
+ * Each recording thread is assigned to one reservoir, so that threads
+ * recording events concurrently rarely contend for the same lock.
+ */
+#define NEWRELIC_APP_EVENTS_SHARDS 8
+
+/*!
+ * @brief The number of events each reservoir holds between flushes. Once a
+ * reservoir is full, further events are sampled.
+ */
+#define NEWRELIC_APP_EVENTS_SHARD_MAX (10 * 1000 / NEWRELIC_APP_EVENTS_SHARDS)
+
+/*! @brief How often, in milliseconds, the reservoirs are sent to the daemon. */
+#define NEWRELIC_APP_EVENTS_FLUSH_MS 1000
+
+/*! @brief A reservoir of app-level custom events and the lock guarding it. */
+typedef struct _newrelic_app_events_shard_t {
+  /*! The shard lock. */
+  nrthread_mutex_t lock;
+
+  /*! The events recorded since the last flush; created when first needed. */
+  nr_analytics_events_t* events;
+
+  /*! The random number generator used to sample a full reservoir. */
+  nr_random_t* rnd;
+
+  /*! Whether custom events may currently be recorded for the application. */
+  bool enabled;
+} newrelic_app_events_shard_t;
+
+/*! @brief The app-level custom event reservoirs and their flusher thread. */
+typedef struct _newrelic_app_events_t {
+  /*! The application the events are recorded for. */
+  newrelic_app_t* app;
+
+  /*! The reservoirs. */
+  newrelic_app_events_shard_t shards[NEWRELIC_APP_EVENTS_SHARDS];
+
+  /*! The random number generator used for batch sampling priorities. */
+  nr_random_t* rnd;
+
+  /*! The flusher thread. */
+  newrelic_app_flusher_t flusher;
+} newrelic_app_events_t;
+
+/*!
+ * @brief Create the app-level custom event reservoirs for an application and
+ * start the thread that flushes them to the daemon.
+ *
+ * @param [in] app A connected application.
+ *
+ * @return The reservoirs; NULL if the flusher thread could not be started.
+ */
+newrelic_app_events_t* newrelic_app_events_create(newrelic_app_t* app);
+
+/*!
+ * @brief Get the app-level custom event reservoirs of an application,
+ * creating them and starting their flusher thread when first called.
+ *
+ * Applications that never record an app-level custom event therefore never
+ * start a flusher thread.
+ *
+ * @param [in] app A connected application.
+ *
+ * @return The reservoirs; NULL if the flusher thread could not be started,
+ * in which case the next call tries again.
+ */
+newrelic_app_events_t* newrelic_app_events_get(newrelic_app_t* app);
+
+/*!
+ * @brief Stop the flusher thread, send any events that remain to the daemon
+ * and free the reservoirs.
+ *
+ * This must be called before the application lock is taken to destroy the
+ * application, since the final flush acquires it.
+ *
+ * @param [in,out] events_ptr The address of the reservoirs to destroy.
+ */
+void newrelic_app_events_destroy(newrelic_app_events_t** events_ptr);
+
+/*!
+ * @brief Add a built custom event to the calling thread's reservoir.
+ *
+ * @param [in] events The reservoirs.
+ * @param [in,out] builder_ptr The address of the event builder. If the event
+ * is offered to a reservoir, the builder is consumed and set to NULL;
+ * otherwise it is left for the caller to destroy.
+ *
+ * @return true if the event was offered to a reservoir; false if custom
+ * events are disabled for the application.
+ */
+bool newrelic_app_events_add(newrelic_app_events_t* events,
+                             nr_custom_event_builder_t** builder_ptr);
+
+/*!
+ * @brief Send every non-empty reservoir to the daemon.
+ *
+ * This is called periodically by the flusher thread; it is exposed for
+ * testing.
+ *
+ * @param [in] events The reservoirs.
+ */
+void newrelic_app_events_flush(newrelic_app_events_t* events);
+
+#endif /* LIBNEWRELIC_APP_EVENTS_H */
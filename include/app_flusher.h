@@ -0,0 +1,79 @@
+/*!
+ * @file app_flusher.h
+ *
+ * @brief Type definitions and function declarations necessary to support
+ * holding data for an application in sharded buffers that a flusher thread
+ * periodically sends to the daemon.
+ */
+#ifndef LIBNEWRELIC_APP_FLUSHER_H
+#define LIBNEWRELIC_APP_FLUSHER_H
+
+#include <stdbool.h>
+
+#include "util_threads.h"
+
+/*!
+ * @brief A function that sends the buffered data to the daemon.
+ *
+ * @param [in] userdata The userdata passed to newrelic_app_flusher_start().
+ */
+typedef void (*newrelic_app_flush_func_t)(void* userdata);
+
+/*! @brief A thread that periodically flushes buffered data. */
+typedef struct _newrelic_app_flusher_t {
+  /*! The flusher thread. */
+  nrthread_t thread;
+
+  /*! The lock guarding the stop flag. */
+  nrthread_mutex_t lock;
+
+  /*! Signalled to wake the flusher thread when it should stop. */
+  pthread_cond_t stop_cond;
+
+  /*! Whether the flusher thread should stop. */
+  bool stopping;
+
+  /*! How often, in milliseconds, the data is flushed. */
+  int period_ms;
+
+  /*! The function that flushes the data, and its argument. */
+  newrelic_app_flush_func_t flush;
+  void* userdata;
+} newrelic_app_flusher_t;
+
+/*!
+ * @brief Start a flusher thread.
+ *
+ * @param [out] flusher The flusher to start.
+ * @param [in] period_ms How often, in milliseconds, to call flush.
+ * @param [in] flush The function that sends the buffered data.
+ * @param [in] userdata The argument passed to flush.
+ *
+ * @return true if the thread was started; false otherwise, in which case the
+ * flusher need not be stopped.
+ */
+bool newrelic_app_flusher_start(newrelic_app_flusher_t* flusher,
+                                int period_ms,
+                                newrelic_app_flush_func_t flush,
+                                void* userdata);
+
+/*!
+ * @brief Stop a flusher thread, and then flush whatever remains.
+ *
+ * @param [in,out] flusher A flusher started by newrelic_app_flusher_start().
+ */
+void newrelic_app_flusher_stop(newrelic_app_flusher_t* flusher);
+
+/*!
+ * @brief Get the shard the calling thread adds buffered data to.
+ *
+ * Threads are assigned shards round robin the first time they ask, which
+ * spreads threads adding data concurrently evenly over the shards.
+ *
+ * @param [in] shards The number of shards.
+ *
+ * @return An index less than shards.
+ */
+int newrelic_app_shard_index(int shards);
+
+#endif /* LIBNEWRELIC_APP_FLUSHER_H */
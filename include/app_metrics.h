@@ -0,0 +1,118 @@
+/*!
+ * @file app_metrics.h
+ *
+ * @brief Type definitions, constants, and function declarations necessary to
+ * support aggregating transaction metrics within the C SDK before they are
+ * sent to the daemon.
+ */
+#ifndef LIBNEWRELIC_APP_METRICS_H
+#define LIBNEWRELIC_APP_METRICS_H
+
+#include "libnewrelic.h"
+#include "app_flusher.h"
+#include "nr_txn.h"
+#include "util_hashmap.h"
+#include "util_metrics.h"
+#include "util_threads.h"
+
+/*!
+ * @brief The number of accumulators transaction metrics are spread across.
+ *
+ * Each thread ending transactions is assigned to one accumulator, so that
+ * threads ending transactions concurrently rarely contend for the same lock.
+ */
+#define NEWRELIC_APP_METRICS_SHARDS 8
+
+/*!
+ * @brief The number of metrics each of an accumulator's tables holds between
+ * flushes.
+ *
+ * A transaction whose metrics would not fit is sent with its metrics, as
+ * though aggregation were disabled, so that no metrics are dropped.
+ */
+#define NEWRELIC_APP_METRICS_SHARD_MAX NR_METRIC_DEFAULT_LIMIT
+
+/*!
+ * @brief The number of transaction names each accumulator holds scoped
+ * metrics for between flushes.
+ */
+#define NEWRELIC_APP_METRICS_SHARD_NAMES 100
+
+/*!
+ * @brief How often, in milliseconds, the accumulators are sent to the daemon.
+ */
+#define NEWRELIC_APP_METRICS_FLUSH_MS 1000
+
+/*! @brief An accumulator of transaction metrics and the lock guarding it. */
+typedef struct _newrelic_app_metrics_shard_t {
+  /*! The shard lock. */
+  nrthread_mutex_t lock;
+
+  /*! The unscoped metrics added since the last flush; created when first
+   * needed. */
+  nrmtable_t* unscoped;
+
+  /*! The scoped metrics added since the last flush, as a table for each
+   * transaction name; created when first needed. */
+  nr_hashmap_t* scoped;
+} newrelic_app_metrics_shard_t;
+
+/*! @brief The transaction metric accumulators and their flusher thread. */
+typedef struct _newrelic_app_metrics_t {
+  /*! The application the metrics are aggregated for. */
+  newrelic_app_t* app;
+
+  /*! The accumulators. */
+  newrelic_app_metrics_shard_t shards[NEWRELIC_APP_METRICS_SHARDS];
+
+  /*! The flusher thread. */
+  newrelic_app_flusher_t flusher;
+} newrelic_app_metrics_t;
+
+/*!
+ * @brief Create the transaction metric accumulators for an application and
+ * start the thread that flushes them to the daemon.
+ *
+ * @param [in] app A connected application.
+ *
+ * @return The accumulators; NULL if the flusher thread could not be started.
+ */
+newrelic_app_metrics_t* newrelic_app_metrics_create(newrelic_app_t* app);
+
+/*!
+ * @brief Stop the flusher thread, send any metrics that remain to the daemon
+ * and free the accumulators.
+ *
+ * This must be called before the application lock is taken to destroy the
+ * application, since the final flush acquires it.
+ *
+ * @param [in,out] metrics_ptr The address of the accumulators to destroy.
+ */
+void newrelic_app_metrics_destroy(newrelic_app_metrics_t** metrics_ptr);
+
+/*!
+ * @brief Add the metrics of an ended transaction to the calling thread's
+ * accumulator.
+ *
+ * @param [in] metrics The accumulators.
+ * @param [in,out] txn The ended transaction. If its metrics are added, it is
+ * marked so that they are not also sent with the transaction. Its metric
+ * tables are left in place, since its events are built from them.
+ *
+ * @return true if the metrics were added; false if they must be sent with
+ * the transaction, because the transaction has no name or the accumulator is
+ * too full to hold them.
+ */
+bool newrelic_app_metrics_add(newrelic_app_metrics_t* metrics, nrtxn_t* txn);
+
+/*!
+ * @brief Send the metrics held by every accumulator to the daemon.
+ *
+ * Metrics are held until the application is connected. This is called
+ * periodically by the flusher thread; it is exposed for testing.
+ *
+ * @param [in] metrics The accumulators.
+ */
+void newrelic_app_metrics_flush(newrelic_app_metrics_t* metrics);
+
+#endif /* LIBNEWRELIC_APP_METRICS_H */
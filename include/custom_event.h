@@ -7,14 +7,16 @@
 #ifndef LIBNEWRELIC_ATTRIBUTE_H
 #define LIBNEWRELIC_ATTRIBUTE_H
 
-#include "util_object.h"
+#include "nr_custom_events.h"
 
 /*!
  * @brief The internal custom event struct
+ *
+ * Attributes are serialized as they are added, so recording the event only
+ * needs to stamp the timestamp into the JSON the builder already holds.
  */
 typedef struct _newrelic_custom_event_t {
-  char* type;
-  nrobj_t* attributes;
+  nr_custom_event_builder_t* builder;
 } newrelic_custom_event_t;
 
 #endif /* LIBNEWRELIC_ATTRIBUTE_H */
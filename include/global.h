@@ -18,6 +18,19 @@
  */
 bool newrelic_do_init(const char* daemon_socket, int time_limit_ms);
 
+/*!
+ * @brief Initialise the C SDK against an in-process stand-in for the daemon.
+ *
+ * Applications connect immediately and transactions are encoded and then
+ * discarded rather than sent, which allows the cost of instrumentation to be
+ * measured without a running daemon. This is intended for benchmarks and
+ * tests only.
+ *
+ * @param [in] flags A bitwise OR of nr_loopback_flags_t values.
+ * @return true on success; false otherwise.
+ */
+bool newrelic_init_loopback(int flags);
+
 /*!
  * @brief Ensure that the C SDK has been initialised.
  *
@@ -12,6 +12,7 @@
 #define LIBNEWRELIC_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -192,6 +193,34 @@ typedef struct _newrelic_transaction_tracer_config_t {
    */
   newrelic_time_us_t stack_trace_threshold_us;
 
+  /**
+   *  @brief Whether to bound the memory used by segments in long
+   *  transactions.
+   *
+   *  If set to true, segments that have ended and can no longer be included
+   *  in the transaction trace or span events are collapsed into their parent
+   *  while the transaction is running. Their metrics and time are recorded
+   *  immediately, so the transaction's metrics are unchanged.
+   *
+   *  Default: false.
+   */
+  bool bounded_segments;
+
+  /**
+   *  @brief Sets the duration below which identical segments are rolled up,
+   *  in microseconds.
+   *
+   *  If set, a segment that ends with the same name and type as the sibling
+   *  segment started immediately before it is merged into that sibling when
+   *  both are shorter than this duration. The merged segment reports the
+   *  number of calls it represents, so that a loop making many identical
+   *  calls is shown as a single segment in the transaction trace. Metrics
+   *  are still recorded for every call.
+   *
+   *  Default: 0, which disables rollup.
+   */
+  newrelic_time_us_t segment_rollup_threshold_us;
+
   /**
    *  @brief The datastore_reporting field of newrelic_transaction_tracer_config_t
    *  is a collection of configuration values that control how certain
@@ -267,6 +296,18 @@ typedef struct _newrelic_datastore_segment_config_t {
    *  corresponding transaction is reported. */
   bool database_name_reporting;
 
+  /** @brief Configuration which controls whether the analysis of SQL
+   *  statements is cached.
+   *
+   *  If set to true, the obfuscated SQL, table name and operation derived
+   *  from the sql field of a newrelic_datastore_segment_params_t are kept in
+   *  a cache shared by every application in the process. Applications which
+   *  issue the same statements repeatedly then only analyse each statement
+   *  once. The cache holds a bounded number of recent statements.
+   *
+   *  Default: false. */
+  bool sql_cache;
+
 } newrelic_datastore_segment_config_t;
 
 /**
@@ -353,6 +394,24 @@ typedef struct _newrelic_app_config_t {
    */
   newrelic_datastore_segment_config_t datastore_tracer;
 
+  /**
+   *  @brief Optional. Controls whether transaction metrics are aggregated
+   *  before they are sent to the daemon.
+   *
+   *  If set to true, the metrics of each transaction are combined with those
+   *  of other transactions within the application, and the combined metrics
+   *  are sent to the daemon about once a second, rather than with every
+   *  transaction. This greatly reduces the data sent to the daemon by
+   *  applications running many short transactions, at the cost of metrics
+   *  reaching New Relic up to a second later. Transaction traces, errors and
+   *  events are still sent with each transaction.
+   *
+   *  Every transaction must be ended before the application is destroyed.
+   *
+   *  Default: false.
+   */
+  bool aggregate_metrics;
+
 } newrelic_app_config_t;
 
 /**
@@ -519,6 +578,33 @@ bool newrelic_configure_log(const char* filename, newrelic_loglevel_t level);
  */
 bool newrelic_init(const char* daemon_socket, int time_limit_ms);
 
+/**
+ * @brief Send transaction data to the daemon through shared memory.
+ *
+ * By default, the C SDK writes each transaction to the daemon socket. Once
+ * this function has been called, the C SDK offers a daemon that supports it a
+ * ring buffer in a file in /dev/shm, which the daemon reads transactions from
+ * directly. All other communication with the daemon continues to use the
+ * socket, and transaction data is still sent through the socket to a daemon
+ * that cannot use the ring, such as an older daemon or one running on another
+ * host. The file is only readable by the user the application runs as, so
+ * the daemon must run as the same user, or as root, to use the ring.
+ *
+ * If the daemon falls behind and the ring fills up, a transaction waits for
+ * up to half a second for space before it is dropped and the connection to
+ * the daemon is re-established.
+ *
+ * If an explicit call to this function is required, it must occur before the
+ * first call to newrelic_init() or newrelic_create_app().
+ *
+ * @param [in] size The size of the ring in bytes, which must be between 64 KB
+ * and 64 MB. If this is 0, a default of 4 MB is used. Transactions larger than
+ * half of the ring are dropped.
+ * @return true on success; false if the size is out of range or the C SDK has
+ * already been initialised.
+ */
+bool newrelic_enable_shared_memory(size_t size);
+
 /**
  * @brief Create a populated application configuration.
  *
@@ -946,6 +1032,31 @@ void newrelic_discard_custom_event(newrelic_custom_event_t** event);
 void newrelic_record_custom_event(newrelic_txn_t* transaction,
                                   newrelic_custom_event_t** event);
 
+/**
+ * @brief Records a custom event outside of any transaction.
+ *
+ * This function adds the custom event to a reservoir belonging to the
+ * application and timestamps it. The reservoir is sent to New Relic in
+ * batches roughly once a second, and when the application is destroyed. This
+ * is intended for code that produces events without a natural transaction,
+ * such as a queue consumer that records an event for every message. It may be
+ * called from many threads at once.
+ *
+ * The same limits apply as to events recorded in transactions: if more events
+ * are recorded than can be sent, a sample of them is sent.
+ *
+ * @param [in] app A valid application, @see newrelic_create_app().
+ * @param [in] event The address of a valid custom event, @see
+ *                   newrelic_create_custom_event(). The event is freed
+ *                   whether or not it is recorded.
+ *
+ * @return true if the event was recorded; false if the parameters are
+ * invalid or custom events are disabled for the application, for example by
+ * high security mode.
+ */
+bool newrelic_record_app_custom_event(newrelic_app_t* app,
+                                      newrelic_custom_event_t** event);
+
 /**
  * @brief Adds an int key/value pair to the custom event's attributes
  *
@@ -18,6 +18,9 @@ typedef struct _newrelic_txn_t {
 
   /*! The transaction lock. */
   nrthread_mutex_t lock;
+
+  /*! The application's aggregated metrics, if metrics are aggregated. */
+  struct _newrelic_app_metrics_t* metrics;
 } newrelic_txn_t;
 
 /*!
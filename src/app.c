@@ -1,5 +1,7 @@
 #include "libnewrelic.h"
 #include "app.h"
+#include "app_events.h"
+#include "app_metrics.h"
 #include "global.h"
 
 #include "nr_agent.h"
@@ -38,6 +40,7 @@ newrelic_app_t* newrelic_create_app(const newrelic_app_config_t* given_config,
                                       given_config->license_key);
 
   config->transaction_tracer = given_config->transaction_tracer;
+  config->aggregate_metrics = given_config->aggregate_metrics;
 
   app_info = (nr_app_info_t*)nr_zalloc(sizeof(nr_app_info_t));
 
@@ -64,6 +67,10 @@ newrelic_app_t* newrelic_create_app(const newrelic_app_config_t* given_config,
     return NULL;
   }
 
+  if (config->aggregate_metrics) {
+    app->metrics = newrelic_app_metrics_create(app);
+  }
+
   return app;
 }
 
@@ -74,6 +81,13 @@ bool newrelic_destroy_app(newrelic_app_t** app) {
 
   nrl_info(NRL_INSTRUMENT, "newrelic shutting down");
 
+  /*
+   * Send any remaining custom events and metrics while the daemon connection
+   * is still open. This takes the application lock, so must happen first.
+   */
+  newrelic_app_events_destroy(&(*app)->events);
+  newrelic_app_metrics_destroy(&(*app)->metrics);
+
   nrt_mutex_lock(&(*app)->lock);
   {
     nr_agent_close_daemon_connection();
@@ -89,6 +103,7 @@ bool newrelic_destroy_app(newrelic_app_t** app) {
   nrt_mutex_unlock(&(*app)->lock);
 
   nrt_mutex_destroy(&(*app)->lock);
+  nrt_mutex_destroy(&(*app)->events_lock);
 
   nr_realfree((void**)app);
 
@@ -0,0 +1,231 @@
+/*
+ * App-level custom events: events recorded without a transaction are held in
+ * per-thread-sharded reservoirs and sent to the daemon in batches by a
+ * flusher thread.
+ */
+#include "libnewrelic.h"
+#include "app.h"
+#include "app_events.h"
+#include "app_flusher.h"
+
+#include <time.h>
+
+#include "nr_agent.h"
+#include "nr_commands.h"
+#include "nr_custom_events.h"
+#include "util_logging.h"
+#include "util_memory.h"
+#include "util_reply.h"
+#include "util_strings.h"
+
+/*
+ * Apply the same high security, security policy and server side settings
+ * that nr_txn_begin() applies to the custom events of a transaction.
+ *
+ * Assumes the application is locked.
+ */
+static bool newrelic_app_events_enabled(const nrapp_t* app) {
+  if (NULL == app || NR_APP_OK != app->state) {
+    return false;
+  }
+
+  if (app->info.high_security) {
+    return false;
+  }
+
+  if (0 == nr_reply_get_bool(app->security_policies, "custom_events", 2)) {
+    return false;
+  }
+
+  if (0 == nr_reply_get_bool(app->connect_reply, "collect_custom_events", 1)) {
+    return false;
+  }
+
+  return true;
+}
+
+static void newrelic_app_events_flush_periodically(void* events) {
+  newrelic_app_events_flush((newrelic_app_events_t*)events);
+}
+
+newrelic_app_events_t* newrelic_app_events_create(newrelic_app_t* app) {
+  newrelic_app_events_t* events;
+  bool enabled;
+  int i;
+
+  if (NULL == app) {
+    return NULL;
+  }
+
+  events = (newrelic_app_events_t*)nr_zalloc(sizeof(newrelic_app_events_t));
+  events->app = app;
+  events->rnd = nr_random_create();
+  nr_random_seed_from_time(events->rnd);
+
+  nrt_mutex_lock(&app->lock);
+  enabled = newrelic_app_events_enabled(app->app);
+  nrt_mutex_unlock(&app->lock);
+
+  for (i = 0; i < NEWRELIC_APP_EVENTS_SHARDS; i++) {
+    newrelic_app_events_shard_t* shard = &events->shards[i];
+
+    nrt_mutex_init(&shard->lock, 0);
+    shard->rnd = nr_random_create_from_seed(
+        nr_random_range(events->rnd, NR_RANDOM_MAX_EXCLUSIVE_LIMIT));
+    shard->enabled = enabled;
+  }
+
+  if (!newrelic_app_flusher_start(&events->flusher,
+                                  NEWRELIC_APP_EVENTS_FLUSH_MS,
+                                  newrelic_app_events_flush_periodically,
+                                  events)) {
+    nrl_error(NRL_INSTRUMENT,
+              "unable to start the custom event flusher thread");
+    for (i = 0; i < NEWRELIC_APP_EVENTS_SHARDS; i++) {
+      nrt_mutex_destroy(&events->shards[i].lock);
+      nr_random_destroy(&events->shards[i].rnd);
+    }
+    nr_random_destroy(&events->rnd);
+    nr_free(events);
+    return NULL;
+  }
+
+  return events;
+}
+
+newrelic_app_events_t* newrelic_app_events_get(newrelic_app_t* app) {
+  newrelic_app_events_t* events;
+
+  if (NULL == app) {
+    return NULL;
+  }
+
+  /*
+   * Once created, the reservoirs live as long as the application, so the
+   * common case needs no lock.
+   */
+  events = __atomic_load_n(&app->events, __ATOMIC_ACQUIRE);
+  if (NULL != events) {
+    return events;
+  }
+
+  nrt_mutex_lock(&app->events_lock);
+  events = app->events;
+  if (NULL == events) {
+    events = newrelic_app_events_create(app);
+    __atomic_store_n(&app->events, events, __ATOMIC_RELEASE);
+  }
+  nrt_mutex_unlock(&app->events_lock);
+
+  return events;
+}
+
+void newrelic_app_events_destroy(newrelic_app_events_t** events_ptr) {
+  newrelic_app_events_t* events;
+  int i;
+
+  if (NULL == events_ptr || NULL == *events_ptr) {
+    return;
+  }
+
+  events = *events_ptr;
+
+  newrelic_app_flusher_stop(&events->flusher);
+
+  for (i = 0; i < NEWRELIC_APP_EVENTS_SHARDS; i++) {
+    newrelic_app_events_shard_t* shard = &events->shards[i];
+
+    nrt_mutex_destroy(&shard->lock);
+    nr_analytics_events_destroy(&shard->events);
+    nr_random_destroy(&shard->rnd);
+  }
+
+  nr_random_destroy(&events->rnd);
+
+  nr_realfree((void**)events_ptr);
+}
+
+bool newrelic_app_events_add(newrelic_app_events_t* events,
+                             nr_custom_event_builder_t** builder_ptr) {
+  newrelic_app_events_shard_t* shard;
+  bool enabled;
+
+  if (NULL == events) {
+    return false;
+  }
+
+  shard
+      = &events->shards[newrelic_app_shard_index(NEWRELIC_APP_EVENTS_SHARDS)];
+
+  nrt_mutex_lock(&shard->lock);
+  {
+    enabled = shard->enabled;
+    if (enabled) {
+      if (NULL == shard->events) {
+        shard->events
+            = nr_analytics_events_create(NEWRELIC_APP_EVENTS_SHARD_MAX);
+      }
+      nr_custom_events_add_built_event(shard->events, builder_ptr,
+                                       nr_get_time(), shard->rnd);
+    }
+  }
+  nrt_mutex_unlock(&shard->lock);
+
+  return enabled;
+}
+
+void newrelic_app_events_flush(newrelic_app_events_t* events) {
+  newrelic_app_t* app;
+  char* agent_run_id = NULL;
+  bool enabled = false;
+  int i;
+
+  if (NULL == events || NULL == events->app) {
+    return;
+  }
+
+  app = events->app;
+
+  /*
+   * Query the daemon about the state of the application, if appropriate, so
+   * that an application only recording events outside of transactions still
+   * notices a new agent run ID or a change to its security policies.
+   */
+  nrt_mutex_lock(&app->lock);
+  if (NULL != app->app) {
+    nr_app_consider_appinfo(app->app, time(0));
+    enabled = newrelic_app_events_enabled(app->app);
+    if (enabled) {
+      agent_run_id = nr_strdup(app->app->agent_run_id);
+    }
+  }
+  nrt_mutex_unlock(&app->lock);
+
+  for (i = 0; i < NEWRELIC_APP_EVENTS_SHARDS; i++) {
+    newrelic_app_events_shard_t* shard = &events->shards[i];
+    nr_analytics_events_t* batch;
+
+    nrt_mutex_lock(&shard->lock);
+    batch = shard->events;
+    shard->events = NULL;
+    shard->enabled = enabled;
+    nrt_mutex_unlock(&shard->lock);
+
+    if (NULL == batch) {
+      continue;
+    }
+
+    if (enabled
+        && NR_FAILURE
+               == nr_cmd_custom_events_tx(nr_get_daemon_fd(), agent_run_id,
+                                          batch,
+                                          nr_random_real(events->rnd))) {
+      nrl_error(NRL_INSTRUMENT, "failed to send %d custom events",
+                nr_analytics_events_number_saved(batch));
+    }
+
+    nr_analytics_events_destroy(&batch);
+  }
+
+  nr_free(agent_run_id);
+}
@@ -0,0 +1,102 @@
+/*
+ * Flusher threads and shard assignment shared by the data that an application
+ * buffers before sending it to the daemon: app-level custom events and
+ * aggregated transaction metrics.
+ */
+#include "libnewrelic.h"
+#include "app_flusher.h"
+
+#include <errno.h>
+#include <time.h>
+
+static nrthread_mutex_t newrelic_app_shard_lock = NRTHREAD_MUTEX_INITIALIZER;
+static int newrelic_app_next_shard;
+static nrt_thread_local int newrelic_app_thread_shard = -1;
+
+int newrelic_app_shard_index(int shards) {
+  if (newrelic_app_thread_shard < 0) {
+    nrt_mutex_lock(&newrelic_app_shard_lock);
+    newrelic_app_thread_shard = newrelic_app_next_shard++;
+    nrt_mutex_unlock(&newrelic_app_shard_lock);
+  }
+
+  return newrelic_app_thread_shard % shards;
+}
+
+static void* newrelic_app_flusher_main(void* arg) {
+  newrelic_app_flusher_t* flusher = (newrelic_app_flusher_t*)arg;
+
+  nrt_mutex_lock(&flusher->lock);
+  while (!flusher->stopping) {
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += flusher->period_ms / 1000;
+    deadline.tv_nsec += (flusher->period_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+
+    while (!flusher->stopping
+           && ETIMEDOUT
+                  != pthread_cond_timedwait(&flusher->stop_cond,
+                                            &flusher->lock, &deadline)) {
+    }
+
+    if (flusher->stopping) {
+      break;
+    }
+
+    nrt_mutex_unlock(&flusher->lock);
+    flusher->flush(flusher->userdata);
+    nrt_mutex_lock(&flusher->lock);
+  }
+  nrt_mutex_unlock(&flusher->lock);
+
+  return NULL;
+}
+
+bool newrelic_app_flusher_start(newrelic_app_flusher_t* flusher,
+                                int period_ms,
+                                newrelic_app_flush_func_t flush,
+                                void* userdata) {
+  if (NULL == flusher || NULL == flush) {
+    return false;
+  }
+
+  flusher->stopping = false;
+  flusher->period_ms = period_ms;
+  flusher->flush = flush;
+  flusher->userdata = userdata;
+  nrt_mutex_init(&flusher->lock, 0);
+  pthread_cond_init(&flusher->stop_cond, NULL);
+
+  if (NR_SUCCESS
+      != nrt_create(&flusher->thread, NULL, newrelic_app_flusher_main,
+                    flusher)) {
+    nrt_mutex_destroy(&flusher->lock);
+    pthread_cond_destroy(&flusher->stop_cond);
+    return false;
+  }
+
+  return true;
+}
+
+void newrelic_app_flusher_stop(newrelic_app_flusher_t* flusher) {
+  if (NULL == flusher) {
+    return;
+  }
+
+  nrt_mutex_lock(&flusher->lock);
+  flusher->stopping = true;
+  pthread_cond_signal(&flusher->stop_cond);
+  nrt_mutex_unlock(&flusher->lock);
+
+  nrt_join(flusher->thread, NULL);
+
+  flusher->flush(flusher->userdata);
+
+  nrt_mutex_destroy(&flusher->lock);
+  pthread_cond_destroy(&flusher->stop_cond);
+}
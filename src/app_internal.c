@@ -51,6 +51,7 @@ nr_status_t newrelic_connect_app(newrelic_app_t* app,
   nrl_info(NRL_INSTRUMENT, "application %s connected",
            NRSAFESTR(app->app_info->appname));
   nrt_mutex_init(&app->lock, 0);
+  nrt_mutex_init(&app->events_lock, 0);
 
   return NR_SUCCESS;
 }
@@ -0,0 +1,281 @@
+/*
+ * Aggregated transaction metrics: when enabled, the metrics of each ended
+ * transaction are merged into per-thread-sharded accumulators rather than
+ * sent with the transaction, and a flusher thread sends the combined tables
+ * to the daemon.
+ *
+ * The daemon records a scoped metric both unscoped and scoped to the name of
+ * the transaction it arrived in, so scoped metrics are accumulated separately
+ * for each transaction name and each name's table is sent as a transaction of
+ * that name.
+ */
+#include "libnewrelic.h"
+#include "app.h"
+#include "app_flusher.h"
+#include "app_metrics.h"
+
+#include "nr_agent.h"
+#include "nr_commands.h"
+#include "util_logging.h"
+#include "util_memory.h"
+#include "util_strings.h"
+
+static void newrelic_app_metrics_table_destroy(void* value) {
+  nrmtable_t* table = (nrmtable_t*)value;
+
+  nrm_table_destroy(&table);
+}
+
+static nr_hashmap_t* newrelic_app_metrics_scoped_create(void) {
+  return nr_hashmap_create(newrelic_app_metrics_table_destroy);
+}
+
+/*
+ * Whether n more metrics can be added to a table, which may be NULL, without
+ * reaching the limit beyond which it would start dropping them.
+ */
+static bool newrelic_app_metrics_fits(const nrmtable_t* table, int n) {
+  return nrm_table_size(table) + n <= NEWRELIC_APP_METRICS_SHARD_MAX;
+}
+
+static void newrelic_app_metrics_flush_periodically(void* metrics) {
+  newrelic_app_metrics_flush((newrelic_app_metrics_t*)metrics);
+}
+
+newrelic_app_metrics_t* newrelic_app_metrics_create(newrelic_app_t* app) {
+  newrelic_app_metrics_t* metrics;
+  int i;
+
+  if (NULL == app) {
+    return NULL;
+  }
+
+  metrics = (newrelic_app_metrics_t*)nr_zalloc(sizeof(newrelic_app_metrics_t));
+  metrics->app = app;
+
+  for (i = 0; i < NEWRELIC_APP_METRICS_SHARDS; i++) {
+    nrt_mutex_init(&metrics->shards[i].lock, 0);
+  }
+
+  if (!newrelic_app_flusher_start(&metrics->flusher,
+                                  NEWRELIC_APP_METRICS_FLUSH_MS,
+                                  newrelic_app_metrics_flush_periodically,
+                                  metrics)) {
+    nrl_error(NRL_INSTRUMENT, "unable to start the metric flusher thread");
+    for (i = 0; i < NEWRELIC_APP_METRICS_SHARDS; i++) {
+      nrt_mutex_destroy(&metrics->shards[i].lock);
+    }
+    nr_free(metrics);
+    return NULL;
+  }
+
+  return metrics;
+}
+
+void newrelic_app_metrics_destroy(newrelic_app_metrics_t** metrics_ptr) {
+  newrelic_app_metrics_t* metrics;
+  int i;
+
+  if (NULL == metrics_ptr || NULL == *metrics_ptr) {
+    return;
+  }
+
+  metrics = *metrics_ptr;
+
+  newrelic_app_flusher_stop(&metrics->flusher);
+
+  for (i = 0; i < NEWRELIC_APP_METRICS_SHARDS; i++) {
+    newrelic_app_metrics_shard_t* shard = &metrics->shards[i];
+
+    nrt_mutex_destroy(&shard->lock);
+    nrm_table_destroy(&shard->unscoped);
+    nr_hashmap_destroy(&shard->scoped);
+  }
+
+  nr_realfree((void**)metrics_ptr);
+}
+
+bool newrelic_app_metrics_add(newrelic_app_metrics_t* metrics, nrtxn_t* txn) {
+  newrelic_app_metrics_shard_t* shard;
+  nrmtable_t* scoped = NULL;
+  size_t name_len;
+  bool added = false;
+
+  if (NULL == metrics || NULL == txn) {
+    return false;
+  }
+
+  name_len = nr_strlen(txn->name);
+  if (0 == name_len) {
+    return false;
+  }
+
+  shard
+      = &metrics->shards[newrelic_app_shard_index(NEWRELIC_APP_METRICS_SHARDS)];
+
+  nrt_mutex_lock(&shard->lock);
+  {
+    if (NULL == shard->scoped) {
+      shard->scoped = newrelic_app_metrics_scoped_create();
+    }
+
+    scoped = (nrmtable_t*)nr_hashmap_get(shard->scoped, txn->name, name_len);
+    if (NULL == scoped
+        && nr_hashmap_count(shard->scoped)
+               >= NEWRELIC_APP_METRICS_SHARD_NAMES) {
+      goto end;
+    }
+
+    if (!newrelic_app_metrics_fits(scoped,
+                                   nrm_table_size(txn->scoped_metrics))
+        || !newrelic_app_metrics_fits(shard->unscoped,
+                                      nrm_table_size(txn->unscoped_metrics))) {
+      goto end;
+    }
+
+    if (NULL == scoped) {
+      scoped = nrm_table_create(NEWRELIC_APP_METRICS_SHARD_MAX);
+      nr_hashmap_set(shard->scoped, txn->name, name_len, scoped);
+    }
+    if (NULL == shard->unscoped) {
+      shard->unscoped = nrm_table_create(NEWRELIC_APP_METRICS_SHARD_MAX);
+    }
+
+    nrm_table_merge(scoped, txn->scoped_metrics);
+    nrm_table_merge(shard->unscoped, txn->unscoped_metrics);
+    added = true;
+  }
+end:
+  nrt_mutex_unlock(&shard->lock);
+
+  /*
+   * The metric tables are kept, since the transaction and error events are
+   * built from them when the transaction is sent.
+   */
+  txn->status.metrics_aggregated = added;
+
+  return added;
+}
+
+/*
+ * The state of a single flush: the metrics of every shard are combined, so
+ * that each transaction name is sent once however many shards it was
+ * accumulated in.
+ */
+typedef struct _newrelic_app_metrics_batch_t {
+  nrmtable_t* unscoped;
+  nr_hashmap_t* scoped;
+  const char* agent_run_id;
+} newrelic_app_metrics_batch_t;
+
+static void newrelic_app_metrics_merge_scoped(void* value,
+                                              const char* key,
+                                              size_t key_len,
+                                              void* user_data) {
+  newrelic_app_metrics_batch_t* batch
+      = (newrelic_app_metrics_batch_t*)user_data;
+  nrmtable_t* table;
+
+  table = (nrmtable_t*)nr_hashmap_get(batch->scoped, key, key_len);
+  if (NULL == table) {
+    table = nrm_table_create(NEWRELIC_APP_METRICS_SHARDS
+                             * NEWRELIC_APP_METRICS_SHARD_MAX);
+    nr_hashmap_set(batch->scoped, key, key_len, table);
+  }
+
+  nrm_table_merge(table, (const nrmtable_t*)value);
+}
+
+static void newrelic_app_metrics_send_scoped(void* value,
+                                             const char* key,
+                                             size_t key_len,
+                                             void* user_data) {
+  newrelic_app_metrics_batch_t* batch
+      = (newrelic_app_metrics_batch_t*)user_data;
+  char* txn_name = nr_strndup(key, key_len);
+
+  if (NR_FAILURE
+      == nr_cmd_metrics_tx(nr_get_daemon_fd(), batch->agent_run_id, txn_name,
+                           (const nrmtable_t*)value, NULL)) {
+    nrl_error(NRL_INSTRUMENT, "failed to send metrics for txnname='%.64s'",
+              txn_name);
+  }
+
+  nr_free(txn_name);
+}
+
+void newrelic_app_metrics_flush(newrelic_app_metrics_t* metrics) {
+  newrelic_app_t* app;
+  newrelic_app_metrics_batch_t batch = {NULL, NULL, NULL};
+  char* agent_run_id = NULL;
+  int i;
+
+  if (NULL == metrics || NULL == metrics->app) {
+    return;
+  }
+
+  app = metrics->app;
+
+  /*
+   * Metrics are kept until the application is connected, rather than being
+   * discarded, since a transaction's metrics are only aggregated once it has
+   * been recorded for a connected application.
+   */
+  nrt_mutex_lock(&app->lock);
+  if (NULL != app->app && NR_APP_OK == app->app->state) {
+    agent_run_id = nr_strdup(app->app->agent_run_id);
+  }
+  nrt_mutex_unlock(&app->lock);
+
+  if (NULL == agent_run_id) {
+    return;
+  }
+
+  batch.agent_run_id = agent_run_id;
+
+  for (i = 0; i < NEWRELIC_APP_METRICS_SHARDS; i++) {
+    newrelic_app_metrics_shard_t* shard = &metrics->shards[i];
+    nrmtable_t* unscoped;
+    nr_hashmap_t* scoped;
+
+    nrt_mutex_lock(&shard->lock);
+    unscoped = shard->unscoped;
+    scoped = shard->scoped;
+    shard->unscoped = NULL;
+    shard->scoped = NULL;
+    nrt_mutex_unlock(&shard->lock);
+
+    if (unscoped) {
+      if (NULL == batch.unscoped) {
+        batch.unscoped = nrm_table_create(NEWRELIC_APP_METRICS_SHARDS
+                                          * NEWRELIC_APP_METRICS_SHARD_MAX);
+      }
+      nrm_table_merge(batch.unscoped, unscoped);
+      nrm_table_destroy(&unscoped);
+    }
+
+    if (scoped) {
+      if (NULL == batch.scoped) {
+        batch.scoped = newrelic_app_metrics_scoped_create();
+      }
+      nr_hashmap_apply(scoped, newrelic_app_metrics_merge_scoped, &batch);
+      nr_hashmap_destroy(&scoped);
+    }
+  }
+
+  if (batch.unscoped
+      && NR_FAILURE
+             == nr_cmd_metrics_tx(nr_get_daemon_fd(), agent_run_id, NULL, NULL,
+                                  batch.unscoped)) {
+    nrl_error(NRL_INSTRUMENT, "failed to send %d unscoped metrics",
+              nrm_table_size(batch.unscoped));
+  }
+
+  if (batch.scoped) {
+    nr_hashmap_apply(batch.scoped, newrelic_app_metrics_send_scoped, &batch);
+  }
+
+  nrm_table_destroy(&batch.unscoped);
+  nr_hashmap_destroy(&batch.scoped);
+  nr_free(agent_run_id);
+}
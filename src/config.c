@@ -91,6 +91,9 @@ nrtxnopt_t* newrelic_get_default_options(void) {
   opt->custom_parameters_enabled = true;
   opt->distributed_tracing_enabled = false;
   opt->span_events_enabled = false;
+  opt->bounded_segments_enabled = false;
+  opt->segment_rollup_threshold = 0;
+  opt->sql_cache_enabled = false;
 
   return opt;
 }
@@ -105,12 +108,18 @@ nrtxnopt_t* newrelic_get_transaction_options(
         = config->datastore_tracer.instance_reporting;
     opt->database_name_reporting_enabled
         = config->datastore_tracer.database_name_reporting;
+    opt->sql_cache_enabled = (int)config->datastore_tracer.sql_cache;
 
     /* Convert public transaction tracer settings to transaction options. */
     opt->tt_enabled = (int)config->transaction_tracer.enabled;
     opt->tt_recordsql = newrelic_validate_recordsql(
         config->transaction_tracer.datastore_reporting.record_sql);
     opt->tt_slowsql = config->transaction_tracer.datastore_reporting.enabled;
+    opt->bounded_segments_enabled
+        = (int)config->transaction_tracer.bounded_segments;
+    opt->segment_rollup_threshold
+        = config->transaction_tracer.segment_rollup_threshold_us
+          * NR_TIME_DIVISOR_US;
 
     opt->ep_threshold
         = config->transaction_tracer.datastore_reporting.threshold_us
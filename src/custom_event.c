@@ -1,4 +1,6 @@
 #include "libnewrelic.h"
+#include "app.h"
+#include "app_events.h"
 #include "custom_event.h"
 #include "transaction.h"
 #include "util_object.h"
@@ -6,6 +8,7 @@
 
 newrelic_custom_event_t* newrelic_create_custom_event(const char* event_type) {
   newrelic_custom_event_t* event;
+  nr_custom_event_builder_t* builder;
 
   // bail if we have an invalid event type
   if (NULL == event_type) {
@@ -13,10 +16,14 @@ newrelic_custom_event_t* newrelic_create_custom_event(const char* event_type) {
     return NULL;
   }
 
-  event = nr_malloc(sizeof(newrelic_custom_event_t));
+  builder = nr_custom_event_builder_create(event_type);
+  if (NULL == builder) {
+    nrl_error(NRL_INSTRUMENT, "invalid event_type '%.128s'", event_type);
+    return NULL;
+  }
 
-  event->type = nr_strdup(event_type);
-  event->attributes = nro_new_hash();
+  event = nr_malloc(sizeof(newrelic_custom_event_t));
+  event->builder = builder;
 
   return event;
 }
@@ -29,8 +36,7 @@ void newrelic_record_custom_event(newrelic_txn_t* transaction,
 
   nrt_mutex_lock(&transaction->lock);
   {
-    nr_txn_record_custom_event(transaction->txn, (*event)->type,
-                               (*event)->attributes);
+    nr_txn_record_built_custom_event(transaction->txn, &(*event)->builder);
   }
   nrt_mutex_unlock(&transaction->lock);
 
@@ -38,13 +44,29 @@ void newrelic_record_custom_event(newrelic_txn_t* transaction,
   newrelic_discard_custom_event(event);
 }
 
+bool newrelic_record_app_custom_event(newrelic_app_t* app,
+                                      newrelic_custom_event_t** event) {
+  bool recorded;
+
+  if (NULL == app || NULL == event || NULL == *event) {
+    return false;
+  }
+
+  recorded = newrelic_app_events_add(newrelic_app_events_get(app),
+                                     &(*event)->builder);
+
+  // free the event after it's been recorded
+  newrelic_discard_custom_event(event);
+
+  return recorded;
+}
+
 void newrelic_discard_custom_event(newrelic_custom_event_t** event) {
   if (NULL == event || NULL == *event) {
     return;
   }
 
-  nr_free((*event)->type);
-  nro_delete((*event)->attributes);
+  nr_custom_event_builder_destroy(&(*event)->builder);
 
   nr_realfree((void**)event);
 }
@@ -55,7 +77,8 @@ bool newrelic_custom_event_add_attribute_int(newrelic_custom_event_t* event,
   if (NULL == event) {
     return false;
   }
-  return NR_SUCCESS == nro_set_hash_int(event->attributes, key, value);
+  return NR_SUCCESS
+         == nr_custom_event_builder_add_long(event->builder, key, value);
 }
 
 bool newrelic_custom_event_add_attribute_long(newrelic_custom_event_t* event,
@@ -64,7 +87,8 @@ bool newrelic_custom_event_add_attribute_long(newrelic_custom_event_t* event,
   if (NULL == event) {
     return false;
   }
-  return NR_SUCCESS == nro_set_hash_long(event->attributes, key, value);
+  return NR_SUCCESS
+         == nr_custom_event_builder_add_long(event->builder, key, value);
 }
 
 bool newrelic_custom_event_add_attribute_double(newrelic_custom_event_t* event,
@@ -73,7 +97,8 @@ bool newrelic_custom_event_add_attribute_double(newrelic_custom_event_t* event,
   if (NULL == event) {
     return false;
   }
-  return NR_SUCCESS == nro_set_hash_double(event->attributes, key, value);
+  return NR_SUCCESS
+         == nr_custom_event_builder_add_double(event->builder, key, value);
 }
 
 bool newrelic_custom_event_add_attribute_string(newrelic_custom_event_t* event,
@@ -83,5 +108,6 @@ bool newrelic_custom_event_add_attribute_string(newrelic_custom_event_t* event,
     return false;
   }
 
-  return NR_SUCCESS == nro_set_hash_string(event->attributes, key, value);
+  return NR_SUCCESS
+         == nr_custom_event_builder_add_string(event->builder, key, value);
 }
@@ -2,9 +2,13 @@
 #include "global.h"
 
 #include "nr_agent.h"
+#include "nr_commands.h"
+#include "nr_loopback.h"
+#include "nr_shm_ring.h"
 #include "util_logging.h"
 #include "util_memory.h"
 #include "util_sleep.h"
+#include "util_sql.h"
 #include "util_strings.h"
 
 #include <stdlib.h>
@@ -52,6 +56,30 @@ bool newrelic_init(const char* daemon_socket, int time_limit_ms) {
   return newrelic_do_init(daemon_socket, time_limit_ms);
 }
 
+bool newrelic_enable_shared_memory(size_t size) {
+  if (NULL != nr_agent_applist) {
+    nrl_error(NRL_API,
+              "newrelic_enable_shared_memory() must be invoked before the C "
+              "SDK is initialised");
+    return false;
+  }
+
+  if (0 == size) {
+    size = NR_SHM_RING_DEFAULT_CAPACITY;
+  }
+
+  if (size < NR_SHM_RING_MIN_CAPACITY || size > NR_SHM_RING_MAX_CAPACITY) {
+    nrl_error(NRL_API,
+              "shared memory size %zu is out of range; must be between %d and "
+              "%d bytes, inclusive",
+              size, NR_SHM_RING_MIN_CAPACITY, NR_SHM_RING_MAX_CAPACITY);
+    return false;
+  }
+
+  nr_agent_set_shared_ring_capacity(size);
+  return true;
+}
+
 bool newrelic_do_init(const char* daemon_socket, int time_limit_ms) {
   const char* path;
 
@@ -86,6 +114,31 @@ bool newrelic_do_init(const char* daemon_socket, int time_limit_ms) {
   return true;
 }
 
+bool newrelic_init_loopback(int flags) {
+  if (NULL != nr_agent_applist) {
+    nrl_error(NRL_API, "the C SDK has already been initialised");
+    return false;
+  }
+
+  if (!newrelic_log_configured) {
+    if (!newrelic_configure_log("stderr", NEWRELIC_LOG_INFO)) {
+      return false;
+    }
+  }
+
+  if (NR_SUCCESS != nr_loopback_start(flags)) {
+    nrl_error(NRL_API, "failed to start the loopback daemon");
+    return false;
+  }
+
+  nr_agent_applist = nr_applist_create();
+
+  atexit(newrelic_shutdown);
+
+  nrl_info(NRL_INSTRUMENT, "newrelic initialized with loopback daemon");
+  return true;
+}
+
 bool newrelic_ensure_init(void) {
   if (NULL != nr_agent_applist) {
     return true;
@@ -96,8 +149,12 @@ bool newrelic_ensure_init(void) {
 }
 
 void newrelic_shutdown(void) {
+  nr_loopback_stop();
   nr_agent_close_daemon_connection();
+  nr_agent_set_shared_ring_capacity(0);
+  nr_txndata_builder_pool_destroy();
   nr_applist_destroy(&nr_agent_applist);
+  nr_sql_cache_clear();
   nrl_close_log_file();
   newrelic_log_configured = false;
 }
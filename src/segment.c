@@ -252,6 +252,10 @@ bool newrelic_end_segment(newrelic_txn_t* transaction,
                   (int)segment->segment->type);
         status = false;
     }
+
+    /* Roll the segment up into an identical sibling, once its metrics have
+     * been added. */
+    nr_segment_rollup(&segment->segment);
   }
   nrt_mutex_unlock(&transaction->lock);
 
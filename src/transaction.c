@@ -1,6 +1,7 @@
 #include "libnewrelic.h"
 
 #include "app.h"
+#include "app_metrics.h"
 #include "config.h"
 #include "global.h"
 #include "segment.h"
@@ -76,6 +77,12 @@ bool newrelic_end_transaction(newrelic_txn_t** transaction_ptr) {
                 txn->options.tt_threshold);
 
     if (0 == txn->status.ignore) {
+      /*
+       * When metrics are aggregated, the transaction is sent without them if
+       * they can be added to the application's accumulator.
+       */
+      newrelic_app_metrics_add(transaction->metrics, txn);
+
       if (NR_FAILURE == nr_cmd_txndata_tx(nr_get_daemon_fd(), txn)) {
         nrl_error(NRL_INSTRUMENT, "failed to send transaction");
         ret = false;
@@ -117,6 +124,8 @@ newrelic_txn_t* newrelic_start_transaction(newrelic_app_t* app,
     return NULL;
   }
 
+  transaction->metrics = app->metrics;
+
   nrt_mutex_lock(&app->lock);
   {
     options = newrelic_get_transaction_options(app->config);
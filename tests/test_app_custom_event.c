@@ -0,0 +1,252 @@
+#include <stdarg.h>
+#include <stddef.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "libnewrelic.h"
+#include "app.h"
+#include "app_events.h"
+#include "custom_event.h"
+
+#include "nr_commands.h"
+#include "util_memory.h"
+#include "util_strings.h"
+#include "util_threads.h"
+
+#include "test.h"
+
+#define RECORDING_THREADS 4
+#define EVENTS_PER_THREAD 100
+
+/*
+ * The batches sent to the daemon. The flusher thread may send a batch at any
+ * time, so the tests only check totals once the reservoirs are destroyed.
+ */
+static nrthread_mutex_t sent_lock = NRTHREAD_MUTEX_INITIALIZER;
+static int batches_sent;
+static int events_sent;
+static char* last_agent_run_id;
+
+static nr_status_t record_custom_events_tx(
+    int daemon_fd NRUNUSED,
+    const char* agent_run_id,
+    const nr_analytics_events_t* custom_events,
+    double priority) {
+  assert_true(priority >= 0.0 && priority < 1.0);
+
+  nrt_mutex_lock(&sent_lock);
+  batches_sent++;
+  events_sent += nr_analytics_events_number_saved(custom_events);
+  nr_free(last_agent_run_id);
+  last_agent_run_id = nr_strdup(agent_run_id);
+  nrt_mutex_unlock(&sent_lock);
+
+  return NR_SUCCESS;
+}
+
+static int setup(void** state) {
+  newrelic_app_t* app = (newrelic_app_t*)*state;
+
+  batches_sent = 0;
+  events_sent = 0;
+  nr_free(last_agent_run_id);
+
+  app->app->agent_run_id = nr_strdup("12345");
+  app->app->info.high_security = 0;
+  nr_cmd_custom_events_hook = record_custom_events_tx;
+
+  return 0;
+}
+
+static int teardown(void** state) {
+  newrelic_app_t* app = (newrelic_app_t*)*state;
+
+  newrelic_app_events_destroy(&app->events);
+  nr_free(app->app->agent_run_id);
+  nr_free(last_agent_run_id);
+  nr_cmd_custom_events_hook = NULL;
+
+  return 0;
+}
+
+static newrelic_custom_event_t* create_event(void) {
+  newrelic_custom_event_t* event = newrelic_create_custom_event("Some Name");
+
+  newrelic_custom_event_add_attribute_int(event, "i", 42);
+  return event;
+}
+
+/*
+ * Purpose: Test that newrelic_record_app_custom_event handles invalid inputs
+ * in a sane way.
+ */
+static void test_app_custom_event_inputs(void** state) {
+  newrelic_app_t* app = (newrelic_app_t*)*state;
+  newrelic_custom_event_t* event = NULL;
+
+  assert_false(newrelic_record_app_custom_event(NULL, NULL));
+  assert_false(newrelic_record_app_custom_event(app, NULL));
+  assert_false(newrelic_record_app_custom_event(app, &event));
+
+  // as with newrelic_record_custom_event, the event is left for the caller to
+  // discard when there is no application
+  event = create_event();
+  assert_false(newrelic_record_app_custom_event(NULL, &event));
+  assert_non_null(event);
+  newrelic_discard_custom_event(&event);
+
+  // invalid inputs do not start the flusher
+  assert_null(app->events);
+  assert_int_equal(0, batches_sent);
+}
+
+/*
+ * Purpose: Test that the reservoirs and their flusher thread are only
+ * created once an event is recorded.
+ */
+static void test_app_custom_event_created_lazily(void** state) {
+  newrelic_app_t* app = (newrelic_app_t*)*state;
+  newrelic_app_events_t* events;
+  newrelic_custom_event_t* event;
+
+  // destroying reservoirs that were never created is harmless
+  assert_null(app->events);
+  newrelic_app_events_destroy(&app->events);
+
+  event = create_event();
+  assert_true(newrelic_record_app_custom_event(app, &event));
+  events = app->events;
+  assert_non_null(events);
+
+  // later events reuse the same reservoirs
+  event = create_event();
+  assert_true(newrelic_record_app_custom_event(app, &event));
+  assert_ptr_equal(events, newrelic_app_events_get(app));
+
+  newrelic_app_events_destroy(&app->events);
+  assert_null(app->events);
+  assert_int_equal(2, events_sent);
+}
+
+/*
+ * Purpose: Test that recorded events are sent when flushed.
+ */
+static void test_app_custom_event_flush(void** state) {
+  newrelic_app_t* app = (newrelic_app_t*)*state;
+  newrelic_custom_event_t* event;
+  int i;
+
+  app->events = newrelic_app_events_create(app);
+
+  for (i = 0; i < 3; i++) {
+    event = create_event();
+    assert_true(newrelic_record_app_custom_event(app, &event));
+    assert_null(event);
+  }
+
+  newrelic_app_events_flush(app->events);
+  nrt_mutex_lock(&sent_lock);
+  assert_int_equal(3, events_sent);
+  assert_string_equal("12345", last_agent_run_id);
+  nrt_mutex_unlock(&sent_lock);
+
+  // nothing is left to send
+  newrelic_app_events_destroy(&app->events);
+  assert_int_equal(3, events_sent);
+}
+
+/*
+ * Purpose: Test that events still held when the reservoirs are destroyed are
+ * sent.
+ */
+static void test_app_custom_event_destroy_flushes(void** state) {
+  newrelic_app_t* app = (newrelic_app_t*)*state;
+  newrelic_custom_event_t* event;
+
+  app->events = newrelic_app_events_create(app);
+
+  event = create_event();
+  assert_true(newrelic_record_app_custom_event(app, &event));
+
+  newrelic_app_events_destroy(&app->events);
+  assert_int_equal(1, batches_sent);
+  assert_int_equal(1, events_sent);
+}
+
+/*
+ * Purpose: Test that events are not recorded in high security mode.
+ */
+static void test_app_custom_event_high_security(void** state) {
+  newrelic_app_t* app = (newrelic_app_t*)*state;
+  newrelic_custom_event_t* event;
+
+  app->app->info.high_security = 1;
+  app->events = newrelic_app_events_create(app);
+
+  event = create_event();
+  assert_false(newrelic_record_app_custom_event(app, &event));
+  assert_null(event);
+
+  newrelic_app_events_destroy(&app->events);
+  assert_int_equal(0, batches_sent);
+}
+
+static void* record_events(void* arg) {
+  newrelic_app_t* app = (newrelic_app_t*)arg;
+  int i;
+
+  for (i = 0; i < EVENTS_PER_THREAD; i++) {
+    newrelic_custom_event_t* event = create_event();
+
+    newrelic_record_app_custom_event(app, &event);
+  }
+
+  return NULL;
+}
+
+/*
+ * Purpose: Test that events recorded from several threads at once are all
+ * sent.
+ */
+static void test_app_custom_event_threads(void** state) {
+  newrelic_app_t* app = (newrelic_app_t*)*state;
+  nrthread_t threads[RECORDING_THREADS];
+  int i;
+
+  app->events = newrelic_app_events_create(app);
+
+  for (i = 0; i < RECORDING_THREADS; i++) {
+    assert_int_equal(NR_SUCCESS,
+                     nrt_create(&threads[i], NULL, record_events, app));
+  }
+  for (i = 0; i < RECORDING_THREADS; i++) {
+    nrt_join(threads[i], NULL);
+  }
+
+  newrelic_app_events_destroy(&app->events);
+  assert_int_equal(RECORDING_THREADS * EVENTS_PER_THREAD, events_sent);
+}
+
+/*
+ * Purpose: Main entry point (i.e. runs the tests)
+ */
+int main(void) {
+  const struct CMUnitTest app_custom_event_tests[] = {
+      cmocka_unit_test_setup_teardown(test_app_custom_event_inputs, setup,
+                                      teardown),
+      cmocka_unit_test_setup_teardown(test_app_custom_event_created_lazily,
+                                      setup, teardown),
+      cmocka_unit_test_setup_teardown(test_app_custom_event_flush, setup,
+                                      teardown),
+      cmocka_unit_test_setup_teardown(test_app_custom_event_destroy_flushes,
+                                      setup, teardown),
+      cmocka_unit_test_setup_teardown(test_app_custom_event_high_security,
+                                      setup, teardown),
+      cmocka_unit_test_setup_teardown(test_app_custom_event_threads, setup,
+                                      teardown),
+  };
+
+  return cmocka_run_group_tests(app_custom_event_tests,  // our tests
+                                app_group_setup, app_group_teardown);
+}
@@ -0,0 +1,329 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "libnewrelic.h"
+#include "app.h"
+#include "app_metrics.h"
+
+#include "nr_analytics_events.h"
+#include "nr_commands.h"
+#include "nr_errors.h"
+#include "util_memory.h"
+#include "util_metrics.h"
+#include "util_strings.h"
+#include "util_threads.h"
+
+#include "test.h"
+
+#define ENDING_THREADS 4
+#define TXNS_PER_THREAD 100
+
+/*
+ * The metrics sent to the daemon. The flusher thread may send metrics at any
+ * time, so the threaded test only checks totals once the accumulators are
+ * destroyed.
+ */
+static nrthread_mutex_t sent_lock = NRTHREAD_MUTEX_INITIALIZER;
+static int messages_sent;
+static nrmtable_t* unscoped_sent;
+static nrmtable_t* scoped_sent;
+static char* last_txn_name;
+static char* last_agent_run_id;
+
+static nr_status_t record_metrics_tx(int daemon_fd NRUNUSED,
+                                     const char* agent_run_id,
+                                     const char* txn_name,
+                                     const nrmtable_t* scoped_metrics,
+                                     const nrmtable_t* unscoped_metrics) {
+  nrt_mutex_lock(&sent_lock);
+  messages_sent++;
+  nrm_table_merge(scoped_sent, scoped_metrics);
+  nrm_table_merge(unscoped_sent, unscoped_metrics);
+  if (txn_name) {
+    nr_free(last_txn_name);
+    last_txn_name = nr_strdup(txn_name);
+  }
+  nr_free(last_agent_run_id);
+  last_agent_run_id = nr_strdup(agent_run_id);
+  nrt_mutex_unlock(&sent_lock);
+
+  return NR_SUCCESS;
+}
+
+static int setup(void** state) {
+  newrelic_app_t* app = (newrelic_app_t*)*state;
+
+  messages_sent = 0;
+  scoped_sent = nrm_table_create(NR_METRIC_DEFAULT_LIMIT);
+  unscoped_sent = nrm_table_create(NR_METRIC_DEFAULT_LIMIT);
+
+  app->app->state = NR_APP_OK;
+  app->app->agent_run_id = nr_strdup("12345");
+  nr_cmd_metrics_hook = record_metrics_tx;
+
+  return 0;
+}
+
+static int teardown(void** state) {
+  newrelic_app_t* app = (newrelic_app_t*)*state;
+
+  newrelic_app_metrics_destroy(&app->metrics);
+  nr_free(app->app->agent_run_id);
+  nrm_table_destroy(&scoped_sent);
+  nrm_table_destroy(&unscoped_sent);
+  nr_free(last_txn_name);
+  nr_free(last_agent_run_id);
+  nr_cmd_metrics_hook = NULL;
+
+  return 0;
+}
+
+/*
+ * Create an ended transaction with one scoped and one unscoped metric.
+ */
+static nrtxn_t* create_txn(const char* name) {
+  nrtxn_t* txn = (nrtxn_t*)nr_zalloc(sizeof(nrtxn_t));
+
+  txn->name = nr_strdup(name);
+  txn->scoped_metrics = nrm_table_create(NR_METRIC_DEFAULT_LIMIT);
+  txn->unscoped_metrics = nrm_table_create(NR_METRIC_DEFAULT_LIMIT);
+  nrm_add(txn->scoped_metrics, "scoped", 1);
+  nrm_add(txn->unscoped_metrics, "unscoped", 2);
+
+  return txn;
+}
+
+static void destroy_txn(nrtxn_t** txn_ptr) {
+  nr_free((*txn_ptr)->name);
+  nr_error_destroy(&(*txn_ptr)->error);
+  nrm_table_destroy(&(*txn_ptr)->scoped_metrics);
+  nrm_table_destroy(&(*txn_ptr)->unscoped_metrics);
+  nr_realfree((void**)txn_ptr);
+}
+
+static nrtime_t count_sent(nrmtable_t* table, const char* name) {
+  return nrm_count(nrm_find(table, name));
+}
+
+/*
+ * Purpose: Test that newrelic_app_metrics_add handles invalid inputs in a
+ * sane way.
+ */
+static void test_app_metrics_inputs(void** state) {
+  newrelic_app_t* app = (newrelic_app_t*)*state;
+  nrtxn_t* txn = create_txn("");
+
+  app->metrics = newrelic_app_metrics_create(app);
+  assert_non_null(app->metrics);
+
+  assert_false(newrelic_app_metrics_add(NULL, txn));
+  assert_false(newrelic_app_metrics_add(app->metrics, NULL));
+
+  // a transaction without a name sends its metrics
+  assert_false(newrelic_app_metrics_add(app->metrics, txn));
+  assert_false(txn->status.metrics_aggregated);
+  destroy_txn(&txn);
+
+  newrelic_app_metrics_destroy(&app->metrics);
+  assert_null(app->metrics);
+  assert_int_equal(0, messages_sent);
+}
+
+/*
+ * Purpose: Test that the metrics of several transactions are combined and
+ * sent when flushed.
+ */
+static void test_app_metrics_flush(void** state) {
+  newrelic_app_t* app = (newrelic_app_t*)*state;
+  nrtxn_t* txn;
+  int i;
+
+  app->metrics = newrelic_app_metrics_create(app);
+
+  for (i = 0; i < 3; i++) {
+    txn = create_txn("WebTransaction/Action/txn");
+    assert_true(newrelic_app_metrics_add(app->metrics, txn));
+    assert_true(txn->status.metrics_aggregated);
+    destroy_txn(&txn);
+  }
+
+  newrelic_app_metrics_flush(app->metrics);
+  nrt_mutex_lock(&sent_lock);
+  // one message for the unscoped metrics and one for the transaction name
+  assert_int_equal(2, messages_sent);
+  assert_int_equal(3, count_sent(scoped_sent, "scoped"));
+  assert_int_equal(3, count_sent(unscoped_sent, "unscoped"));
+  assert_string_equal("WebTransaction/Action/txn", last_txn_name);
+  assert_string_equal("12345", last_agent_run_id);
+  nrt_mutex_unlock(&sent_lock);
+
+  // nothing is left to send
+  newrelic_app_metrics_destroy(&app->metrics);
+  assert_int_equal(2, messages_sent);
+}
+
+/*
+ * Purpose: Test that metrics are held while the application is not
+ * connected.
+ */
+static void test_app_metrics_not_connected(void** state) {
+  newrelic_app_t* app = (newrelic_app_t*)*state;
+  nrtxn_t* txn = create_txn("WebTransaction/Action/txn");
+
+  app->metrics = newrelic_app_metrics_create(app);
+  assert_true(newrelic_app_metrics_add(app->metrics, txn));
+  destroy_txn(&txn);
+
+  app->app->state = NR_APP_UNKNOWN;
+  newrelic_app_metrics_flush(app->metrics);
+  assert_int_equal(0, messages_sent);
+
+  app->app->state = NR_APP_OK;
+  newrelic_app_metrics_destroy(&app->metrics);
+  assert_int_equal(2, messages_sent);
+  assert_int_equal(1, count_sent(unscoped_sent, "unscoped"));
+}
+
+/*
+ * Purpose: Test that a transaction whose metrics would not fit in the
+ * accumulator keeps them.
+ */
+static void test_app_metrics_full(void** state) {
+  newrelic_app_t* app = (newrelic_app_t*)*state;
+  nrtxn_t* txn;
+  char name[64];
+  int i;
+
+  app->metrics = newrelic_app_metrics_create(app);
+
+  // every transaction name after the limit is rejected
+  for (i = 0; i < NEWRELIC_APP_METRICS_SHARD_NAMES; i++) {
+    snprintf(name, sizeof(name), "WebTransaction/Action/%d", i);
+    txn = create_txn(name);
+    assert_true(newrelic_app_metrics_add(app->metrics, txn));
+    destroy_txn(&txn);
+  }
+
+  txn = create_txn("WebTransaction/Action/one too many");
+  assert_false(newrelic_app_metrics_add(app->metrics, txn));
+  assert_false(txn->status.metrics_aggregated);
+  destroy_txn(&txn);
+
+  // as are metrics that would overflow a table
+  txn = create_txn("WebTransaction/Action/0");
+  for (i = 0; i < NEWRELIC_APP_METRICS_SHARD_MAX; i++) {
+    snprintf(name, sizeof(name), "Custom/%d", i);
+    nrm_add(txn->unscoped_metrics, name, 1);
+  }
+  assert_false(newrelic_app_metrics_add(app->metrics, txn));
+  assert_false(txn->status.metrics_aggregated);
+  destroy_txn(&txn);
+
+  newrelic_app_metrics_destroy(&app->metrics);
+  assert_int_equal(NEWRELIC_APP_METRICS_SHARD_NAMES + 1, messages_sent);
+  assert_int_equal(NEWRELIC_APP_METRICS_SHARD_NAMES,
+                   count_sent(unscoped_sent, "unscoped"));
+}
+
+/*
+ * Purpose: Test that the event attributes built from the metrics of a
+ * transaction survive its metrics being aggregated.
+ */
+static void test_app_metrics_event_attributes(void** state) {
+  newrelic_app_t* app = (newrelic_app_t*)*state;
+  nrtxn_t* txn = create_txn("WebTransaction/Action/txn");
+  nr_analytics_event_t* event;
+  const char* json;
+
+  txn->options.analytics_events_enabled = 1;
+  txn->options.error_events_enabled = 1;
+  txn->error = nr_error_create(1, "message", "class", "[]", 0);
+  nrm_add(txn->unscoped_metrics, "WebFrontend/QueueTime", 1 * NR_TIME_DIVISOR);
+  nrm_add(txn->unscoped_metrics, "External/all", 2 * NR_TIME_DIVISOR);
+  nrm_add(txn->unscoped_metrics, "Datastore/all", 3 * NR_TIME_DIVISOR);
+
+  app->metrics = newrelic_app_metrics_create(app);
+  assert_true(newrelic_app_metrics_add(app->metrics, txn));
+
+  event = nr_txn_to_event(txn);
+  json = nr_analytics_event_json(event);
+  assert_non_null(nr_strstr(json, "\"queueDuration\":1.00000"));
+  assert_non_null(nr_strstr(json, "\"externalDuration\":2.00000"));
+  assert_non_null(nr_strstr(json, "\"databaseDuration\":3.00000"));
+  assert_non_null(nr_strstr(json, "\"databaseCallCount\":1"));
+  nr_analytics_event_destroy(&event);
+
+  event = nr_error_to_event(txn);
+  json = nr_analytics_event_json(event);
+  assert_non_null(nr_strstr(json, "\"externalCallCount\":1"));
+  assert_non_null(nr_strstr(json, "\"databaseCallCount\":1"));
+  nr_analytics_event_destroy(&event);
+
+  destroy_txn(&txn);
+  newrelic_app_metrics_destroy(&app->metrics);
+  assert_int_equal(1, count_sent(unscoped_sent, "External/all"));
+}
+
+static void* end_txns(void* arg) {
+  newrelic_app_t* app = (newrelic_app_t*)arg;
+  int i;
+
+  for (i = 0; i < TXNS_PER_THREAD; i++) {
+    nrtxn_t* txn = create_txn("WebTransaction/Action/txn");
+
+    newrelic_app_metrics_add(app->metrics, txn);
+    destroy_txn(&txn);
+  }
+
+  return NULL;
+}
+
+/*
+ * Purpose: Test that the metrics of transactions ended on several threads at
+ * once are all sent.
+ */
+static void test_app_metrics_threads(void** state) {
+  newrelic_app_t* app = (newrelic_app_t*)*state;
+  nrthread_t threads[ENDING_THREADS];
+  int i;
+
+  app->metrics = newrelic_app_metrics_create(app);
+
+  for (i = 0; i < ENDING_THREADS; i++) {
+    assert_int_equal(NR_SUCCESS, nrt_create(&threads[i], NULL, end_txns, app));
+  }
+  for (i = 0; i < ENDING_THREADS; i++) {
+    nrt_join(threads[i], NULL);
+  }
+
+  newrelic_app_metrics_destroy(&app->metrics);
+  assert_int_equal(ENDING_THREADS * TXNS_PER_THREAD,
+                   count_sent(scoped_sent, "scoped"));
+  assert_int_equal(ENDING_THREADS * TXNS_PER_THREAD,
+                   count_sent(unscoped_sent, "unscoped"));
+}
+
+/*
+ * Purpose: Main entry point (i.e. runs the tests)
+ */
+int main(void) {
+  const struct CMUnitTest app_metrics_tests[] = {
+      cmocka_unit_test_setup_teardown(test_app_metrics_inputs, setup,
+                                      teardown),
+      cmocka_unit_test_setup_teardown(test_app_metrics_flush, setup, teardown),
+      cmocka_unit_test_setup_teardown(test_app_metrics_not_connected, setup,
+                                      teardown),
+      cmocka_unit_test_setup_teardown(test_app_metrics_full, setup, teardown),
+      cmocka_unit_test_setup_teardown(test_app_metrics_event_attributes, setup,
+                                      teardown),
+      cmocka_unit_test_setup_teardown(test_app_metrics_threads, setup,
+                                      teardown),
+  };
+
+  return cmocka_run_group_tests(app_metrics_tests,  // our tests
+                                app_group_setup, app_group_teardown);
+}
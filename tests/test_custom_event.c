@@ -1,5 +1,6 @@
 #include <stdarg.h>
 #include <stddef.h>
+#include <math.h>
 
 #include <setjmp.h>
 #include <cmocka.h>
@@ -50,7 +51,7 @@ static void test_custom_event(void** state) {
   newrelic_custom_event_t* custom_event;
 
   custom_event = newrelic_create_custom_event("Some Name");
-  assert_string_equal(custom_event->type, "Some Name");
+  assert_non_null(custom_event->builder);
 
   assert_true(newrelic_custom_event_add_attribute_int(custom_event, "i", 42));
 
@@ -72,7 +73,7 @@ static void test_custom_event_discard(void** state NRUNUSED) {
   newrelic_custom_event_t* custom_event;
 
   custom_event = newrelic_create_custom_event("Some Name");
-  assert_string_equal(custom_event->type, "Some Name");
+  assert_non_null(custom_event->builder);
 
   assert_true(newrelic_custom_event_add_attribute_int(custom_event, "i", 42));
 
@@ -87,6 +88,26 @@ static void test_custom_event_discard(void** state NRUNUSED) {
   assert_null(custom_event);
 }
 
+/*
+ * Purpose: Test that invalid attributes are rejected as they are added
+ */
+static void test_custom_event_invalid_attributes(void** state NRUNUSED) {
+  newrelic_custom_event_t* custom_event;
+
+  assert_null(newrelic_create_custom_event(""));
+
+  custom_event = newrelic_create_custom_event("Some Name");
+
+  assert_false(newrelic_custom_event_add_attribute_int(custom_event, NULL, 1));
+  assert_false(newrelic_custom_event_add_attribute_int(custom_event, "", 1));
+  assert_false(
+      newrelic_custom_event_add_attribute_double(custom_event, "d", NAN));
+  assert_false(
+      newrelic_custom_event_add_attribute_double(custom_event, "d", INFINITY));
+
+  newrelic_discard_custom_event(&custom_event);
+}
+
 /*
  * Purpose: Main entry point (i.e. runs the tests)
  */
@@ -95,6 +116,7 @@ int main(void) {
       cmocka_unit_test(test_custom_event_inputs),
       cmocka_unit_test(test_custom_event),
       cmocka_unit_test(test_custom_event_discard),
+      cmocka_unit_test(test_custom_event_invalid_attributes),
   };
 
   return cmocka_run_group_tests(external_tests,  // our tests
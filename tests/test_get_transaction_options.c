@@ -53,6 +53,83 @@ static void test_get_transaction_options_tt_disabled(void** state NRUNUSED) {
   newrelic_destroy_app_config(&config);
 }
 
+/*
+ * Purpose: Test that affirms the transaction options with the SQL cache
+ *          enabled are correct.
+ */
+static void test_get_transaction_options_sql_cache(void** state NRUNUSED) {
+  nrtxnopt_t* actual;
+  nrtxnopt_t* expected;
+  newrelic_app_config_t* config
+      = newrelic_create_app_config("app name", LICENSE_KEY);
+
+  config->datastore_tracer.sql_cache = true;
+
+  actual = newrelic_get_transaction_options(config);
+  expected = newrelic_get_default_options();
+
+  expected->sql_cache_enabled = true;
+
+  /* Assert that the options were set accordingly. */
+  assert_true(nr_txn_cmp_options(actual, expected));
+
+  nr_free(actual);
+  nr_free(expected);
+  newrelic_destroy_app_config(&config);
+}
+
+/*
+ * Purpose: Test that affirms the transaction options with bounded segments
+ *          enabled are correct.
+ */
+static void test_get_transaction_options_tt_bounded_segments(
+    void** state NRUNUSED) {
+  nrtxnopt_t* actual;
+  nrtxnopt_t* expected;
+  newrelic_app_config_t* config
+      = newrelic_create_app_config("app name", LICENSE_KEY);
+
+  config->transaction_tracer.bounded_segments = true;
+
+  actual = newrelic_get_transaction_options(config);
+  expected = newrelic_get_default_options();
+
+  expected->bounded_segments_enabled = true;
+
+  /* Assert that the options were set accordingly. */
+  assert_true(nr_txn_cmp_options(actual, expected));
+
+  nr_free(actual);
+  nr_free(expected);
+  newrelic_destroy_app_config(&config);
+}
+
+/*
+ * Purpose: Test that affirms the transaction options with a segment rollup
+ *          threshold are correct.
+ */
+static void test_get_transaction_options_tt_segment_rollup(
+    void** state NRUNUSED) {
+  nrtxnopt_t* actual;
+  nrtxnopt_t* expected;
+  newrelic_app_config_t* config
+      = newrelic_create_app_config("app name", LICENSE_KEY);
+
+  config->transaction_tracer.segment_rollup_threshold_us = 1000;
+
+  actual = newrelic_get_transaction_options(config);
+  expected = newrelic_get_default_options();
+
+  expected->segment_rollup_threshold = 1000 * NR_TIME_DIVISOR_US;
+
+  /* Assert that the options were set accordingly. */
+  assert_true(nr_txn_cmp_options(actual, expected));
+
+  nr_free(actual);
+  nr_free(expected);
+  newrelic_destroy_app_config(&config);
+}
+
 /*
  * Purpose: Test that affirms the transaction options with the transaction
  *          tracer enabled and set to apdex mode are correct.
@@ -301,6 +378,9 @@ int main(void) {
   const struct CMUnitTest options_tests[] = {
       cmocka_unit_test(test_get_transaction_options_default),
       cmocka_unit_test(test_get_transaction_options_tt_disabled),
+      cmocka_unit_test(test_get_transaction_options_tt_bounded_segments),
+      cmocka_unit_test(test_get_transaction_options_sql_cache),
+      cmocka_unit_test(test_get_transaction_options_tt_segment_rollup),
       cmocka_unit_test(test_get_transaction_options_tt_threshold_apdex),
       cmocka_unit_test(test_get_transaction_options_tt_threshold_duration),
       cmocka_unit_test(
@@ -8,6 +8,8 @@
 #include "global.h"
 #include "nr_agent.h"
 #include "nr_axiom.h"
+#include "nr_loopback.h"
+#include "nr_shm_ring.h"
 
 #include "test.h"
 
@@ -191,6 +193,53 @@ static void test_init(void** state NRUNUSED) {
   assert_false(newrelic_init("/dev/null", 20));
 }
 
+static void test_init_loopback(void** state NRUNUSED) {
+  // Implicit log configuration fails.
+  expect_string(__wrap_nrl_set_log_file, filename, "stderr");
+  will_return(__wrap_nrl_set_log_file, NR_FAILURE);
+  assert_false(newrelic_init_loopback(NR_LOOPBACK_DISCARD));
+  assert_false(nr_loopback_is_running());
+  assert_true(NULL == nr_agent_applist);
+
+  // Success. The daemon connection functions must not be called.
+  expect_string(__wrap_nrl_set_log_file, filename, "stderr");
+  will_return(__wrap_nrl_set_log_file, NR_SUCCESS);
+  expect_string(__wrap_nrl_set_log_level, level, "info");
+  will_return(__wrap_nrl_set_log_level, NR_SUCCESS);
+  assert_true(newrelic_init_loopback(NR_LOOPBACK_VALIDATE));
+  assert_true(nr_loopback_is_running());
+  assert_int_equal(NR_LOOPBACK_DAEMON_FD, nr_get_daemon_fd());
+  assert_true(NULL != nr_agent_applist);
+
+  // A subsequent call should fail, as should newrelic_init().
+  assert_false(newrelic_init_loopback(NR_LOOPBACK_VALIDATE));
+  assert_false(newrelic_init("/dev/null", 20));
+
+  // Shutting down stops the loopback.
+  newrelic_shutdown();
+  assert_false(nr_loopback_is_running());
+  assert_true(NULL == nr_agent_applist);
+}
+
+static void test_enable_shared_memory(void** state NRUNUSED) {
+  // Sizes out of range are rejected.
+  assert_false(newrelic_enable_shared_memory(1));
+  assert_false(newrelic_enable_shared_memory(NR_SHM_RING_MAX_CAPACITY + 1));
+
+  // The default and sizes in range are accepted.
+  assert_true(newrelic_enable_shared_memory(0));
+  assert_true(newrelic_enable_shared_memory(NR_SHM_RING_MIN_CAPACITY));
+  assert_true(newrelic_enable_shared_memory(NR_SHM_RING_MAX_CAPACITY));
+
+  // Once the C SDK has been initialised, it is too late.
+  expect_string(__wrap_nrl_set_log_file, filename, "stderr");
+  will_return(__wrap_nrl_set_log_file, NR_SUCCESS);
+  expect_string(__wrap_nrl_set_log_level, level, "info");
+  will_return(__wrap_nrl_set_log_level, NR_SUCCESS);
+  assert_true(newrelic_init_loopback(NR_LOOPBACK_DISCARD));
+  assert_false(newrelic_enable_shared_memory(0));
+}
+
 static void test_shutdown(void** state NRUNUSED) {
   // Without initialisation, this should succeed, silently.
   newrelic_shutdown();
@@ -225,6 +274,9 @@ int main(void) {
       cmocka_unit_test_setup_teardown(test_do_init, setup, teardown),
       cmocka_unit_test_setup_teardown(test_ensure_init, setup, teardown),
       cmocka_unit_test_setup_teardown(test_init, setup, teardown),
+      cmocka_unit_test_setup_teardown(test_init_loopback, setup, teardown),
+      cmocka_unit_test_setup_teardown(test_enable_shared_memory, setup,
+                                      teardown),
       cmocka_unit_test_setup_teardown(test_shutdown, setup, teardown),
   };
 
@@ -50,6 +50,29 @@ static void test_segment_set_timing(void** state) {
   assert_int_equal(3, txn_seg->stop_time);
 }
 
+static void test_segment_rollup(void** state) {
+  newrelic_txn_t* txn = (newrelic_txn_t*)*state;
+  newrelic_segment_t* parent = newrelic_start_segment(txn, "parent", NULL);
+  nr_segment_t* parent_seg = parent->segment;
+  nr_segment_t* rollup;
+  int i;
+
+  txn->txn->options.segment_rollup_threshold = 60 * NR_TIME_DIVISOR;
+
+  for (i = 0; i < 3; i++) {
+    newrelic_segment_t* call = newrelic_start_segment(txn, "call", NULL);
+
+    newrelic_end_segment(txn, &call);
+  }
+
+  /* Identical calls should be rolled up into the first. */
+  assert_int_equal(1, nr_vector_size(&parent_seg->children));
+  rollup = (nr_segment_t*)nr_vector_get(&parent_seg->children, 0);
+  assert_int_equal(3, rollup->count);
+
+  newrelic_end_segment(txn, &parent);
+}
+
 static void test_segment_validate_success(void** state NRUNUSED) {
   assert_true(newrelic_validate_segment_param("Should pass", "param"));
 }
@@ -80,6 +103,8 @@ int main(void) {
                                       txn_group_teardown),
       cmocka_unit_test_setup_teardown(test_segment_set_timing, txn_group_setup,
                                       txn_group_teardown),
+      cmocka_unit_test_setup_teardown(test_segment_rollup, txn_group_setup,
+                                      txn_group_teardown),
       cmocka_unit_test_setup_teardown(test_segment_validate_success,
                                       txn_group_setup, txn_group_teardown),
       cmocka_unit_test_setup_teardown(test_segment_validate_failure,